@@ -0,0 +1,119 @@
+#!/bin/bash
+
+# Times each phase of the compiler on synthetic programs of growing size and
+# prints a scaling table. Each sweep doubles one dimension of the program
+# while keeping the others at their base value; the "growth" column is the
+# ratio of the compile time to the previous row's, so it stays near 2 for
+# linear behavior and climbs towards 4 for quadratic behavior.
+
+# Fetch the inputs
+if test $# -lt 1 ; then
+  echo "USAGE: `basename $0` COMPILER [STEPS]" ;
+  exit 1;
+fi
+compiler=`realpath $1` ;
+steps=${2:-5} ;
+
+# Define the variables
+scriptDir=`dirname \`realpath $0\`` ;
+benchDir=`mktemp -d` ;
+trap "rm -rf ${benchDir}" EXIT ;
+
+# the shape that the sweeps start from
+baseFunctions=8 ;
+baseBlocks=16 ;
+baseVars=8 ;
+baseDepth=2 ;
+callDensity=0.2 ;
+
+# The phases of the -T report that get a column, in the order the report
+# lists them, each as "phase name:column header".
+phases=(
+  "parse:parse"
+  "build trees:trees"
+  "inlining:inlining"
+  "tail recursion:tail rec"
+  "data flow:data flow"
+  "constants:constants"
+  "branches:branches"
+  "value numbering:numbering"
+  "loop invariants:invariants"
+  "dead code:dead code"
+  "merge trees:merge"
+  "block layout:layout"
+  "tile trees:tile"
+  "peephole:peephole"
+  "emit:emit"
+) ;
+phaseNames=`printf "%s\n" "${phases[@]}" | cut -d: -f1 | paste -s -d '|'` ;
+phaseHeaders=() ;
+for phase in "${phases[@]}" ; do
+  phaseHeaders+=("${phase#*:}") ;
+done
+
+printRow () {
+  printf "%-10s %8s" "$1" "$2" ;
+  shift 2 ;
+  printf " %10s" "${@:1:$#-1}" ;
+  printf " %8s\n" "${@: -1}" ;
+}
+
+# Compiles a program of the shape given as arguments and prints one row of
+# the table. Sets `elapsed` to the wall time of the compile, and compares it
+# to the value `elapsed` had before.
+benchmark () {
+  local label=$1 functions=$2 blocks=$3 vars=$4 depth=$5 ;
+  local program=${benchDir}/bench.L3 ;
+  python3 ${scriptDir}/generate_l3.py --functions ${functions} --blocks ${blocks} --vars ${vars} --depth ${depth} --call-density ${callDensity} > ${program} ;
+  local numInstructions=`grep -c -v -e '^define' -e '^}' -e '^\s*:' ${program}` ;
+
+  # the compiler writes prog.L2 into the current directory
+  local report ;
+  if ! report=`cd ${benchDir} && ${compiler} -T ${program} 2>&1 >/dev/null` ; then
+    echo "${report}" ;
+    exit 1 ;
+  fi
+  local row=`echo "${report}" | awk -v label=${label} -v insts=${numInstructions} -v previous=${elapsed} -v phaseNames="${phaseNames}" '
+    # the per-function table comes after the first blank line
+    /^$/ { done = 1 }
+    done { next }
+    /^elapsed / { elapsed = $2 ; next }
+    NF >= 3 {
+      name = $0 ;
+      sub(/ +[0-9.]+ +[0-9.]+$/, "", name) ;
+      wall[name] = $(NF - 1) ;
+    }
+    END {
+      growth = previous > 0 ? sprintf("%.2f", elapsed / previous) : "-" ;
+      printf "%-10s %8d", label, insts ;
+      numPhases = split(phaseNames, names, "|") ;
+      for (i = 1 ; i <= numPhases ; i++) {
+        printf " %10.4f", wall[names[i]] ;
+      }
+      printf " %10.4f %8s %s", elapsed, growth, elapsed ;
+    }'` ;
+  echo "${row% *}" ;
+  elapsed=${row##* } ;
+}
+
+# Runs a sweep that doubles the dimension named by $1
+sweep () {
+  local dimension=$1 ;
+  local functions=${baseFunctions} blocks=${baseBlocks} vars=${baseVars} depth=${baseDepth} ;
+  elapsed=0 ;
+  echo "" ;
+  printRow "${dimension}" "insts" "${phaseHeaders[@]}" "elapsed" "growth" ;
+  for (( i = 0 ; i < ${steps} ; i++ )) ; do
+    case ${dimension} in
+      functions) benchmark ${functions} ${functions} ${blocks} ${vars} ${depth} ; functions=$(( functions * 2 )) ;;
+      blocks) benchmark ${blocks} ${functions} ${blocks} ${vars} ${depth} ; blocks=$(( blocks * 2 )) ;;
+      vars) benchmark ${vars} ${functions} ${blocks} ${vars} ${depth} ; vars=$(( vars * 2 )) ;;
+      depth) benchmark ${depth} ${functions} ${blocks} ${vars} ${depth} ; depth=$(( depth * 2 )) ;;
+    esac
+  done
+}
+
+echo "compile time in seconds; phases are summed over functions" ;
+for dimension in functions blocks vars depth ; do
+  sweep ${dimension} ;
+done
@@ -0,0 +1,85 @@
+#!/bin/bash
+
+# Compiles each test at -O0 and at -O3, runs both binaries, and reports the
+# tests whose output differs. Needs no oracle outputs: -O0 turns every
+# optimization pass off, so its output is the reference. The tests must run
+# to completion on their own (reading a .in file if they take input), and a
+# binary that runs for longer than the time limit counts as a failure.
+
+# Fetch the inputs
+if test $# -lt 3 ; then
+  echo "USAGE: `basename $0` EXTENSION_FILE COMPILER TESTS_DIR" ;
+  exit 1;
+fi
+extFile=$1 ;
+compiler=$2 ;
+testsDir=$3 ;
+timeLimit=10 ;
+
+# Check the tests directory
+if ! test -d ${testsDir} ; then
+  echo "The directory \"${testsDir}\" does not exist." ;
+  exit 1 ;
+fi
+
+# Colors
+red=`tput setaf 1`
+green=`tput setaf 2`
+reset=`tput sgr0`
+
+# Compiles the test given as the first argument at the optimization level
+# given as the second, runs it, and stores its output in the file given as
+# the third. Fails if the test doesn't compile or runs out of time.
+runAtLevel () {
+  local test=$1 level=$2 output=$3 ;
+  rm -f ./a.out ;
+  if ! ./${compiler} -O ${level} ${test} &> /dev/null ; then
+    rm -f ${output} ;
+    return 1 ;
+  fi
+  local input=/dev/null ;
+  if test -f ${test}.in ; then
+    input=${test}.in ;
+  fi
+  timeout ${timeLimit} ./a.out < ${input} > ${output} 2>&1 ;
+  if test $? -eq 124 ; then
+    echo "timed out after ${timeLimit} seconds at -O ${level}" >> ${output} ;
+    return 1 ;
+  fi
+  return 0 ;
+}
+
+# Run the tests
+passed=0 ;
+failed=0 ;
+testsFailed="" ;
+for i in `ls -S -r ${testsDir}/*.${extFile}` ; do
+  printf "%-60s " `basename ${i}` ;
+  didSucceed=0 ;
+  if runAtLevel ${i} 0 ${i}.O0.tmp && runAtLevel ${i} 3 ${i}.O3.tmp ; then
+    if cmp ${i}.O0.tmp ${i}.O3.tmp &> /dev/null ; then
+      didSucceed=1 ;
+    fi
+  fi
+  if test $didSucceed == "1" ; then
+    let passed=$passed+1 ;
+    echo "${green}[OK]${reset}" ;
+    rm -f ${i}.O0.tmp ${i}.O3.tmp ;
+  else
+    let failed=$failed+1 ;
+    echo "${red}[FAILED]${reset}" ;
+    testsFailed="`basename ${i}` ${testsFailed}" ;
+  fi
+done
+let total=$passed+$failed ;
+
+# Print summary
+echo "" ;
+echo "########## SUMMARY" ;
+if test "${testsFailed}" != "" ; then
+  echo "Failed tests (their outputs are kept as .O0.tmp and .O3.tmp): ${testsFailed}" ;
+fi
+echo "Test passed: $passed out of $total"
+if test $failed -ne 0 ; then
+  exit 1 ;
+fi
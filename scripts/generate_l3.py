@@ -0,0 +1,82 @@
+#!/usr/bin/env python3
+"""Emits a synthetic L3 program of a configurable shape to stdout.
+
+Used by bench_compile.sh to measure how compile time scales. The programs
+are valid L3 and terminate, but what they compute is meaningless.
+"""
+
+import argparse
+import random
+
+OPERATORS = ["+", "-", "*", "&", "<<", ">>", "<", "<=", "=", ">=", ">"]
+
+
+def generate_function(args, rng, index):
+	name = "main" if index == 0 else "f%d" % index
+	num_params = 0 if index == 0 else index % 4
+	params = ["%%p%d" % i for i in range(num_params)]
+	variables = ["%%v%d" % i for i in range(args.vars)]
+	lines = ["define @%s(%s) {" % (name, ", ".join(params))]
+
+	for i, var in enumerate(variables):
+		lines.append("\t%s <- %s" % (var, params[i % num_params] if params else rng.randint(0, 9)))
+	lines.append("\t%counter <- 0")
+
+	for block in range(args.blocks):
+		lines.append("\t:b%d" % block)
+
+		# a chain of single-use temporaries that merge_trees can fold into
+		# one computation tree of the given depth
+		previous = rng.choice(variables)
+		for level in range(args.depth):
+			temp = "%%t%d_%d" % (block, level)
+			operand = rng.choice(variables + [str(rng.randint(0, 9))])
+			lines.append("\t%s <- %s %s %s" % (temp, previous, rng.choice(OPERATORS), operand))
+			previous = temp
+		lines.append("\t%s <- %s" % (rng.choice(variables), previous))
+
+		# calls only go to later functions so there is no recursion
+		if index + 1 < args.functions and rng.random() < args.call_density:
+			callee = rng.randint(index + 1, args.functions - 1)
+			call_args = ", ".join(rng.choice(variables) for _ in range(callee % 4))
+			lines.append("\t%s <- call @f%d(%s)" % (rng.choice(variables), callee, call_args))
+
+		# end the block with a bounded back edge, a forward branch, or a
+		# fall through
+		choice = rng.random()
+		if block > 0 and choice < 0.2:
+			lines.append("\t%counter <- %counter + 1")
+			lines.append("\t%loop <- %counter < 2")
+			lines.append("\tbr %%loop :b%d" % rng.randint(0, block))
+		elif choice < 0.5 and block + 1 < args.blocks:
+			lines.append("\t%%cond <- %s = 1" % rng.choice(variables))
+			lines.append("\tbr %%cond :b%d" % rng.randint(block + 1, args.blocks - 1))
+
+	if index == 0:
+		lines.append("\tcall print(1)")
+		lines.append("\treturn")
+	else:
+		lines.append("\treturn %s" % rng.choice(variables))
+	lines.append("}")
+	return lines
+
+
+def main():
+	parser = argparse.ArgumentParser(description=__doc__)
+	parser.add_argument("--functions", type=int, default=10, help="number of functions, including @main")
+	parser.add_argument("--blocks", type=int, default=10, help="basic blocks per function")
+	parser.add_argument("--vars", type=int, default=10, help="long-lived variables per function")
+	parser.add_argument("--depth", type=int, default=3, help="depth of the mergeable computation tree in each block")
+	parser.add_argument("--call-density", type=float, default=0.2, help="probability that a block calls another function")
+	parser.add_argument("--seed", type=int, default=0)
+	args = parser.parse_args()
+
+	rng = random.Random(args.seed)
+	lines = []
+	for index in range(args.functions):
+		lines += generate_function(args, rng, index)
+	print("\n".join(lines))
+
+
+if __name__ == "__main__":
+	main()
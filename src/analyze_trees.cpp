@@ -5,69 +5,94 @@
 namespace L3::program {
 	using namespace std_alias;
 
-	void BasicBlock::generate_computation_trees() {
-		// generate the computation trees
+	void BasicBlock::generate_computation_trees(Arena &arena) {
 		for (const Uptr<Instruction> &inst : this->raw_instructions) {
-			this->tree_boxes.emplace_back(*inst);
+			this->tree_boxes.emplace_back(*inst, arena);
 		}
-
+	}
+	void BasicBlock::generate_gen_kill_sets(const Vec<Uptr<Variable>> &function_vars) {
 		// generate the gen and kill set
 		// the algorithm starts at the end of the block
 		VarLiveness &l = this->var_liveness;
+		l.gen_set = VarSet(function_vars);
+		l.kill_set = VarSet(function_vars);
 		for (auto it = this->tree_boxes.rbegin(); it != this->tree_boxes.rend(); ++it) {
 			const Opt<Variable *> &var_written = it->get_var_written();
 			if (var_written) {
 				l.kill_set.insert(*var_written);
 				l.gen_set.erase(*var_written);
 			}
-			l.gen_set += it->get_variables_read();
+			for (Variable *var : it->get_variables_read()) {
+				l.gen_set.insert(var);
+			}
 		}
 
 		// set the initial value of the in and out sets to satisfy the liveness equations
 		l.in_set = l.gen_set;
-		l.out_set = {}; // should already be empty but just in case
+		l.out_set = VarSet(function_vars);
+	}
+	bool BasicBlock::falls_through() const {
+		if (this->tree_boxes.empty()) {
+			return true;
+		}
+		const ComputationNode &last_tree = *this->tree_boxes.back().get_tree();
+		if (const BranchCn *branch_node = dynamic_cast<const BranchCn *>(&last_tree)) {
+			return branch_node->condition.has_value();
+		}
+		if (const CallCn *call_node = dynamic_cast<const CallCn *>(&last_tree)) {
+			return !analyze::get_call_effects(*call_node).never_returns;
+		}
+		return !is_dynamic_type<ReturnCn>(last_tree);
+	}
+	void BasicBlock::generate_succ_blocks(const Vec<Uptr<BasicBlock>> &blocks) {
+		for (size_t i = 0; i < blocks.size(); ++i) {
+			BasicBlock &block = *blocks[i];
+			block.succ_blocks.clear();
+			if (!block.tree_boxes.empty()) {
+				if (const BranchCn *branch_node = dynamic_cast<const BranchCn *>(block.tree_boxes.back().get_tree().get())) {
+					block.succ_blocks.push_back(branch_node->jmp_dest);
+				}
+			}
+			if (block.falls_through() && i + 1 < blocks.size()) {
+				block.succ_blocks.push_back(blocks[i + 1].get());
+			}
+		}
+	}
+	void BasicBlock::replace_succ_block(BasicBlock *old_succ, BasicBlock *new_succ) {
+		std::replace(this->succ_blocks.begin(), this->succ_blocks.end(), old_succ, new_succ);
+		if (this->tree_boxes.empty()) {
+			return;
+		}
+		// only the last tree of a block can be a branch
+		if (BranchCn *branch_node = dynamic_cast<BranchCn *>(this->tree_boxes.back().get_tree().get())) {
+			if (branch_node->jmp_dest == old_succ) {
+				branch_node->jmp_dest = new_succ;
+			}
+		}
 	}
 	bool BasicBlock::update_in_out_sets() {
 		VarLiveness &l = this->var_liveness;
-		bool sets_changed = false;
 
 		// out[i] = UNION (s in successors(i)) {in[s]}
-		Set<Variable *> new_out_set;
+		VarSet new_out_set = l.out_set;
+		new_out_set.clear();
 		for (BasicBlock *succ : this->succ_blocks) {
-			new_out_set += succ->var_liveness.in_set;
+			new_out_set |= succ->var_liveness.in_set;
 		}
 		if (l.out_set != new_out_set) {
-			sets_changed = true;
 			l.out_set = mv(new_out_set);
 		}
 
 		// in[i] = gen[i] UNION (out[i] MINUS kill[i])
-		// Everything currently in in[i] is either there because it was
-		// in gen[i] or because it's in out[i]. out[i] is the only thing
-		// that might have changed. Assuming that this equation is
-		// upheld in the previous iteration, these operations will
-		// satisfy the formula again.
-		// - remove all existing elements that are not in out[i] nor gen[i]
-		// - add all elements that are in out[i] but not kill[i]
-		Set<Variable *> new_in_set;
-		for (Variable *var : l.in_set) {
-			if (l.out_set.find(var) != l.out_set.end()
-				|| l.gen_set.find(var) != l.gen_set.end())
-			{
-				new_in_set.insert(var);
-			}
-		}
-		for (Variable *var : l.out_set) {
-			if (l.kill_set.find(var) == l.kill_set.end()) {
-				new_in_set.insert(var);
-			}
+		VarSet new_in_set = l.out_set;
+		new_in_set -= l.kill_set;
+		new_in_set |= l.gen_set;
+		// only a change to the in set can affect the other blocks
+		if (l.in_set == new_in_set) {
+			return false;
 		}
-		if (l.in_set != new_in_set) {
-			sets_changed = true;
-			l.in_set = mv(new_in_set);
-		}
-
-		return sets_changed;
+		l.in_set = mv(new_in_set);
+		return true;
 	}
 	using Iter = Vec<ComputationTreeBox>::reverse_iterator;
 	// helper function; attempts to merge the ComputationTreeBox at the
@@ -84,16 +109,20 @@ namespace L3::program {
 		Iter result_iter = child_iter;
 
 		// attempt to merge on the variable that the tree writes to
-		const Uptr<ComputationNode> &tree = child_iter->get_tree();
+		const ArenaUptr<ComputationNode> &tree = child_iter->get_tree();
 		if (!tree->destination) { return result_iter; }
 		Variable *merge_var = *tree->destination;
 
+		// a call can't be moved, since it has to stay in order with the
+		// other calls and the loads and stores around it
+		bool is_movable = !is_dynamic_type<CallCn>(*tree);
+
 		// the variable must still be alive after this write
 		auto alive_until_it = alive_until.find(merge_var);
 		if (alive_until_it != alive_until.end()) {
 			// the variable must be alive up until a tree within the same basic
 			// block (i.e. not until the end of the block)
-			if (alive_until_it->second.has_value()) {
+			if (is_movable && alive_until_it->second.has_value()) {
 				Iter parent_iter = *alive_until_it->second;
 
 				// there must be no instructions between the child and parent
@@ -109,8 +138,8 @@ namespace L3::program {
 					}
 				}
 				if (!has_conflict) {
-					// if the child is a load, there must be no stores between
-					// the child and parent
+					// if the child is a load, there must be nothing that might
+					// write memory between the child and parent
 					if (!child_iter->get_has_load()
 						|| !earliest_store
 						|| *earliest_store <= parent_iter)
@@ -152,7 +181,8 @@ namespace L3::program {
 		// Maps a variable to its earliest write seen so far within this basic block
 		Map<Variable *, Iter> earliest_write;
 
-		// Stores the earliest store tree seen so far within this basic block
+		// Stores the earliest tree seen so far within this basic block that
+		// might write memory (a store or some calls)
 		Opt<Iter> earliest_store;
 
 		for (Iter it = this->tree_boxes.rbegin(); it != this->tree_boxes.rend(); ++it) {
@@ -163,8 +193,12 @@ namespace L3::program {
 
 			Iter new_it = attempt_merge(it, alive_until, earliest_write, earliest_store);
 
-			if (new_it->get_has_store()) {
-				earliest_store = it;
+			// a tree that merged into a store ends up where the store is, so
+			// it only counts as a store as early as its parent (and the
+			// parent can't be earlier than a store seen before it)
+			bool writes_memory = new_it->get_has_store() || analyze::may_write_memory(*new_it->get_tree());
+			if (writes_memory && (!earliest_store || new_it > *earliest_store)) {
+				earliest_store = new_it;
 			}
 
 			// add the current tree as a merge candidate for the variables it reads
@@ -195,25 +229,101 @@ namespace L3::program {
 namespace L3::program::analyze {
 	using namespace std_alias;
 
-	void generate_data_flow(L3Function &l3_function) {
+	FunctionEffects get_call_effects(const CallCn &call_node) {
+		const FunctionCn *callee_node = dynamic_cast<const FunctionCn *>(call_node.callee.get());
+		if (!callee_node) {
+			return FunctionEffects::unknown();
+		}
+		if (const ExternalFunction *callee = dynamic_cast<const ExternalFunction *>(callee_node->function)) {
+			return callee->get_effects();
+		}
+		FunctionEffects effects = FunctionEffects::unknown();
+		effects.never_returns = callee_node->function->get_never_returns();
+		return effects;
+	}
+
+	bool may_write_memory(const ComputationNode &tree) {
+		if (const CallCn *call_node = dynamic_cast<const CallCn *>(&tree)) {
+			return get_call_effects(*call_node).writes_memory;
+		}
+		return is_dynamic_type<StoreCn>(tree);
+	}
+
+	Vec<BasicBlock *> get_postorder(L3Function &l3_function) {
+		Vec<Uptr<BasicBlock>> &basic_blocks = l3_function.get_blocks();
+		Vec<BasicBlock *> postorder;
+		postorder.reserve(basic_blocks.size());
+		Set<BasicBlock *> visited;
+
+		// iterative so that long chains of blocks can't overflow the stack.
+		// each stack entry is a block and the index of its next successor
+		// to visit
+		Vec<Pair<BasicBlock *, size_t>> stack;
+		auto visit = [&](BasicBlock *root) {
+			if (!visited.insert(root).second) {
+				return;
+			}
+			stack.push_back({ root, 0 });
+			while (!stack.empty()) {
+				auto &[block, next_succ_index] = stack.back();
+				const Vec<BasicBlock *> &succ_blocks = block->get_succ_blocks();
+				if (next_succ_index < succ_blocks.size()) {
+					BasicBlock *succ = succ_blocks[next_succ_index];
+					next_succ_index += 1;
+					if (visited.insert(succ).second) {
+						stack.push_back({ succ, 0 });
+					}
+				} else {
+					postorder.push_back(block);
+					stack.pop_back();
+				}
+			}
+		};
+		for (Uptr<BasicBlock> &block : basic_blocks) {
+			// the first block is the entry, so it's visited first
+			visit(block.get());
+		}
+		return postorder;
+	}
+
+	void generate_computation_trees(L3Function &l3_function) {
+		for (Uptr<BasicBlock> &block : l3_function.get_blocks()) {
+			block->generate_computation_trees(l3_function.get_node_arena());
+		}
+	}
+
+	int generate_data_flow(L3Function &l3_function) {
 		Vec<Uptr<BasicBlock>> &basic_blocks = l3_function.get_blocks();
 
-		// generate computation trees for this block
 		for (Uptr<BasicBlock> &block : basic_blocks) {
-			block->generate_computation_trees();
+			block->generate_gen_kill_sets(l3_function.get_vars());
 		}
 
-		// update the in and out sets for all the blocks until a fixed point
-		// is reached
-		bool sets_changed;
-		do {
-			sets_changed = false;
-			for (Uptr<BasicBlock> &block : basic_blocks) {
-				if (block->update_in_out_sets()) {
-					sets_changed = true;
+		// Update the in and out sets with a worklist until a fixed point is
+		// reached. Liveness flows backwards, so the worklist is seeded in
+		// reverse of the reverse postorder (i.e. in postorder) so that, apart
+		// from back edges, a block is visited after all of its successors.
+		// After that, a block is only revisited when the in set of one of
+		// its successors has changed.
+		Vec<BasicBlock *> worklist = get_postorder(l3_function);
+		std::reverse(worklist.begin(), worklist.end()); // popped from the back
+		Set<BasicBlock *> in_worklist(worklist.begin(), worklist.end());
+		int num_iterations = 0;
+		while (!worklist.empty()) {
+			BasicBlock *block = worklist.back();
+			worklist.pop_back();
+			in_worklist.erase(block);
+			num_iterations += 1;
+
+			if (block->update_in_out_sets()) {
+				for (BasicBlock *pred : block->get_pred_blocks()) {
+					if (in_worklist.insert(pred).second) {
+						worklist.push_back(pred);
+					}
 				}
 			}
-		} while (sets_changed);
+		}
+		return num_iterations;
 	}
 
 	// basically take the completed program and generate computation trees
@@ -221,15 +331,20 @@ namespace L3::program::analyze {
 	// in and out sets
 	void generate_data_flow(Program &program) {
 		for (Uptr<L3Function> &l3_function : program.get_l3_functions()) {
+			generate_computation_trees(*l3_function);
 			generate_data_flow(*l3_function);
 		}
 	}
 
+	void merge_trees(L3Function &l3_function) {
+		for (Uptr<BasicBlock> &basic_block : l3_function.get_blocks()) {
+			basic_block->merge_trees();
+		}
+	}
+
 	void merge_trees(Program &program) {
 		for (Uptr<L3Function> &l3_function : program.get_l3_functions()) {
-			for (Uptr<BasicBlock> &basic_block : l3_function->get_blocks()) {
-				basic_block->merge_trees();
-			}
+			merge_trees(*l3_function);
 		}
 	}
 }
\ No newline at end of file
@@ -2,7 +2,30 @@
 #include "program.h"
 
 namespace L3::program::analyze {
-	void generate_data_flow(L3Function &l3_function);
+	// Returns the blocks of the function in postorder of a depth-first
+	// traversal from the entry block, followed by any blocks unreachable
+	// from the entry.
+	Vec<BasicBlock *> get_postorder(L3Function &l3_function);
+
+	// The effects of the call, which are only known when it calls an
+	// external function directly; any other call is assumed to do
+	// anything, and to never return only if it calls an L3 function that
+	// is known to never return.
+	FunctionEffects get_call_effects(const CallCn &call_node);
+
+	// whether running the tree might change memory that already exists: a
+	// store, or a call to a function that might write memory
+	bool may_write_memory(const ComputationNode &tree);
+
+	// Generates a computation tree for each instruction of the function.
+	void generate_computation_trees(L3Function &l3_function);
+
+	// Assumes that the computation trees of the function have been
+	// generated. Solves for the in and out sets of its basic blocks from
+	// the trees as they are now, so it can be rerun after the trees change.
+	// Returns the number of times a block's sets were updated before
+	// reaching a fixed point.
+	int generate_data_flow(L3Function &l3_function);
 
 	// Takes the completed program and generates computation trees
 	// for each instruction, then updates all the basic blocks to have correct
@@ -13,6 +36,10 @@ namespace L3::program::analyze {
 	// Merges trees whenever possible.
 	void merge_trees(BasicBlock &block);
 
+	// Assumes that data flow has already been generated for the function.
+	// Merges trees in all of its basic blocks.
+	void merge_trees(L3Function &l3_function);
+
 	// Assumes that data flow has already been generated for the program.
 	// Merges trees in all the basic blocks.
 	void merge_trees(Program &program);
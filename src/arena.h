@@ -0,0 +1,83 @@
+#pragma once
+
+#include "std_alias.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+
+namespace arena {
+	using namespace std_alias;
+
+	// Deleter for objects allocated in an Arena: runs the destructor but
+	// leaves the memory alone, since the Arena frees all of it at once.
+	template<typename T>
+	struct ArenaDeleter {
+		ArenaDeleter() = default;
+
+		// allows an ArenaUptr<Derived> to become an ArenaUptr<Base>, like
+		// std::default_delete does
+		template<typename U, typename = std::enable_if_t<std::is_convertible_v<U *, T *>>>
+		ArenaDeleter(const ArenaDeleter<U> &) {}
+
+		void operator()(T *ptr) const {
+			ptr->~T();
+		}
+	};
+
+	template<typename T>
+	using ArenaUptr = std::unique_ptr<T, ArenaDeleter<T>>;
+
+	// A bump allocator. Objects are carved out of large chunks one after the
+	// other, and all the chunks are freed together by `release`. This makes
+	// allocating many small objects cheap and keeps objects made together
+	// close together in memory.
+	// Not thread-safe; every thread should use its own Arena.
+	class Arena {
+		static const size_t CHUNK_SIZE = 64 * 1024;
+
+		Vec<Uptr<std::byte[]>> chunks;
+		std::byte *next_free; // the next unused byte of the last chunk
+		size_t num_free; // the number of unused bytes in the last chunk
+
+		public:
+
+		Arena() : next_free { nullptr }, num_free { 0 } {}
+		Arena(const Arena &) = delete;
+		Arena &operator=(const Arena &) = delete;
+
+		template<typename T, typename... Args>
+		ArenaUptr<T> make(Args &&... args) {
+			void *memory = this->allocate(sizeof(T), alignof(T));
+			return ArenaUptr<T>(new (memory) T(std::forward<Args>(args)...));
+		}
+
+		// Frees all the memory of the arena at once. Every object made by
+		// this arena must already have been destroyed.
+		void release() {
+			this->chunks.clear();
+			this->next_free = nullptr;
+			this->num_free = 0;
+		}
+
+		private:
+
+		void *allocate(size_t size, size_t alignment) {
+			size_t padding = (alignment - reinterpret_cast<uintptr_t>(this->next_free) % alignment) % alignment;
+			if (!this->next_free || padding + size > this->num_free) {
+				// start a new chunk; chunks from operator new[] are aligned
+				// well enough for any of the objects we make
+				size_t chunk_size = size > CHUNK_SIZE ? size : CHUNK_SIZE;
+				this->chunks.emplace_back(new std::byte[chunk_size]);
+				this->next_free = this->chunks.back().get();
+				this->num_free = chunk_size;
+				padding = 0;
+			}
+			void *result = this->next_free + padding;
+			this->next_free += padding + size;
+			this->num_free -= padding + size;
+			return result;
+		}
+	};
+}
@@ -0,0 +1,452 @@
+#include "block_layout.h"
+#include "analyze_trees.h"
+#include "branch_simplification.h"
+#include "loops.h"
+#include "target_arch.h"
+#include "std_alias.h"
+#include <algorithm>
+
+namespace L3::program::analyze {
+	using namespace std_alias;
+
+	// whether the tree calls a function that never returns, like the ones
+	// that report an error and end the program
+	bool calls_never_returning_function(const ComputationNode &tree) {
+		const CallCn *call_node = dynamic_cast<const CallCn *>(&tree);
+		return call_node && get_call_effects(*call_node).never_returns;
+	}
+
+	// Returns the blocks that are unlikely to run: the ones that call a
+	// function that never returns, the ones whose successors are all cold
+	// (they can only lead to an error), and the ones whose predecessors are
+	// all cold. The entry block is never cold.
+	Set<BasicBlock *> find_cold_blocks(const Vec<Uptr<BasicBlock>> &blocks) {
+		Set<BasicBlock *> cold_blocks;
+		for (size_t i = 1; i < blocks.size(); ++i) {
+			for (const ComputationTreeBox &tree_box : blocks[i]->get_tree_boxes()) {
+				if (calls_never_returning_function(*tree_box.get_tree())) {
+					cold_blocks.insert(blocks[i].get());
+					break;
+				}
+			}
+		}
+		auto all_cold = [&](const Vec<BasicBlock *> &neighbors) {
+			return !neighbors.empty() && std::all_of(neighbors.begin(), neighbors.end(), [&](BasicBlock *neighbor) {
+				return cold_blocks.count(neighbor) > 0;
+			});
+		};
+		bool changed = true;
+		while (changed) {
+			changed = false;
+			for (size_t i = 1; i < blocks.size(); ++i) {
+				BasicBlock *block = blocks[i].get();
+				if (cold_blocks.count(block) > 0) {
+					continue;
+				}
+				if (all_cold(block->get_succ_blocks()) || all_cold(block->get_pred_blocks())) {
+					cold_blocks.insert(block);
+					changed = true;
+				}
+			}
+		}
+		return cold_blocks;
+	}
+
+	// The operator that gives the opposite result, if there is one. There
+	// is no "not equal" operator, so `=` can't be negated.
+	Opt<Operator> negate_operator(Operator op) {
+		switch (op) {
+			case Operator::lt: return Operator::ge;
+			case Operator::le: return Operator::gt;
+			case Operator::ge: return Operator::lt;
+			case Operator::gt: return Operator::le;
+			default: return {};
+		}
+	}
+
+	// The condition of a branch is only a comparison once the trees have
+	// been merged; before that it is a variable or a number.
+	BinaryCn *get_negatable_condition_nullable(BranchCn &branch_node) {
+		BinaryCn *bin_node = dynamic_cast<BinaryCn *>(branch_node.condition->get());
+		return bin_node && negate_operator(bin_node->op) ? bin_node : nullptr;
+	}
+
+	// Makes a copy of the tree in the arena, or returns null for the trees
+	// that aren't worth copying (calls, memory stores, and conditional
+	// branches).
+	ArenaUptr<ComputationNode> clone_tree_nullable(const ComputationNode &tree, Arena &arena) {
+		ArenaUptr<ComputationNode> result;
+		if (const NumberCn *num_node = dynamic_cast<const NumberCn *>(&tree)) {
+			result = arena.make<NumberCn>(num_node->value);
+		} else if (const VariableCn *var_node = dynamic_cast<const VariableCn *>(&tree)) {
+			result = arena.make<VariableCn>(*var_node->destination);
+		} else if (const LabelCn *label_node = dynamic_cast<const LabelCn *>(&tree)) {
+			result = arena.make<LabelCn>(label_node->jmp_dest);
+		} else if (const FunctionCn *function_node = dynamic_cast<const FunctionCn *>(&tree)) {
+			result = arena.make<FunctionCn>(function_node->function);
+		} else if (const MoveCn *move_node = dynamic_cast<const MoveCn *>(&tree)) {
+			ArenaUptr<ComputationNode> source = clone_tree_nullable(*move_node->source, arena);
+			if (source) {
+				result = arena.make<MoveCn>(move_node->destination, mv(source));
+			}
+		} else if (const BinaryCn *bin_node = dynamic_cast<const BinaryCn *>(&tree)) {
+			ArenaUptr<ComputationNode> lhs = clone_tree_nullable(*bin_node->lhs, arena);
+			ArenaUptr<ComputationNode> rhs = clone_tree_nullable(*bin_node->rhs, arena);
+			if (lhs && rhs) {
+				result = arena.make<BinaryCn>(bin_node->destination, bin_node->op, mv(lhs), mv(rhs));
+			}
+		} else if (const LoadCn *load_node = dynamic_cast<const LoadCn *>(&tree)) {
+			ArenaUptr<ComputationNode> address = clone_tree_nullable(*load_node->address, arena);
+			if (address) {
+				result = arena.make<LoadCn>(load_node->destination, mv(address));
+			}
+		} else if (const ReturnCn *return_node = dynamic_cast<const ReturnCn *>(&tree)) {
+			if (!return_node->value) {
+				result = arena.make<ReturnCn>();
+			} else if (ArenaUptr<ComputationNode> value = clone_tree_nullable(**return_node->value, arena)) {
+				result = arena.make<ReturnCn>(mv(value));
+			}
+		} else if (const BranchCn *branch_node = dynamic_cast<const BranchCn *>(&tree)) {
+			if (!branch_node->condition) {
+				result = arena.make<BranchCn>(branch_node->jmp_dest, Opt<ArenaUptr<ComputationNode>>());
+			}
+		}
+		if (result) {
+			// the tiles read the destinations of the inner nodes too
+			result->destination = tree.destination;
+		}
+		return result;
+	}
+
+	// Returns copies of the trees of the block if it is small enough to be
+	// copied into the blocks that jump to it, and ends without falling
+	// through.
+	Opt<Vec<ArenaUptr<ComputationNode>>> clone_small_block(const BasicBlock &block, Arena &arena) {
+		if (block.falls_through()) {
+			return {};
+		}
+		Vec<ArenaUptr<ComputationNode>> result;
+		for (const ComputationTreeBox &tree_box : block.get_tree_boxes()) {
+			const ComputationNode &tree = *tree_box.get_tree();
+			if (is_dynamic_type<NoOpCn>(tree)) {
+				continue;
+			}
+			if (result.size() == MAX_DUPLICATED_TREES) {
+				return {};
+			}
+			ArenaUptr<ComputationNode> clone = clone_tree_nullable(tree, arena);
+			if (!clone) {
+				return {};
+			}
+			result.push_back(mv(clone));
+		}
+		return result;
+	}
+
+	class BlockLayout {
+		L3Function &l3_function;
+		Vec<Uptr<BasicBlock>> &blocks;
+		Map<BasicBlock *, BasicBlock *> fallthrough_succs; // from the layout before this pass
+		Map<BasicBlock *, BasicBlock *> final_dests; // from the trees before this pass
+		Set<BasicBlock *> cold_blocks;
+		Map<BasicBlock *, const Loop *> innermost_loops;
+		Vec<Loop> loops;
+		int num_generated_labels;
+
+		public:
+
+		explicit BlockLayout(L3Function &l3_function) :
+			l3_function { l3_function },
+			blocks { l3_function.get_blocks() },
+			num_generated_labels { 0 }
+		{
+			BasicBlock::generate_succ_blocks(this->blocks);
+			BasicBlock::generate_pred_blocks(this->blocks);
+			for (size_t i = 0; i + 1 < this->blocks.size(); ++i) {
+				if (this->blocks[i]->falls_through()) {
+					this->fallthrough_succs.insert({ this->blocks[i].get(), this->blocks[i + 1].get() });
+				}
+			}
+			for (const Uptr<BasicBlock> &block : this->blocks) {
+				this->final_dests.insert({ block.get(), this->find_final_dest(block.get()) });
+			}
+			this->cold_blocks = find_cold_blocks(this->blocks);
+			Dominators dominators(l3_function);
+			this->loops = find_loops(l3_function, dominators);
+			// the inner loops come first, so the first loop found for a
+			// block is its innermost one
+			for (const Loop &loop : this->loops) {
+				for (BasicBlock *block : loop.blocks) {
+					this->innermost_loops.insert({ block, &loop });
+				}
+			}
+		}
+
+		void lay_out() {
+			Vec<BasicBlock *> order = this->chain_blocks();
+			Map<BasicBlock *, Uptr<BasicBlock>> owned_blocks;
+			for (Uptr<BasicBlock> &block : this->blocks) {
+				BasicBlock *block_ptr = block.get();
+				owned_blocks.insert({ block_ptr, mv(block) });
+			}
+			this->blocks.clear();
+			for (BasicBlock *block : order) {
+				this->blocks.push_back(mv(owned_blocks.at(block)));
+			}
+			this->fix_up_edges();
+			this->duplicate_small_blocks();
+			this->remove_unused_blocks();
+			BasicBlock::generate_succ_blocks(this->blocks);
+			BasicBlock::generate_pred_blocks(this->blocks);
+		}
+
+		private:
+
+		// Returns where control ends up after going through the blocks
+		// that only jump or fall through somewhere else, stopping at a cycle.
+		BasicBlock *find_final_dest(BasicBlock *dest) const {
+			Set<BasicBlock *> visited;
+			while (visited.insert(dest).second) {
+				const Vec<ComputationTreeBox> &tree_boxes = dest->get_tree_boxes();
+				auto last_it = std::find_if(tree_boxes.rbegin(), tree_boxes.rend(), [](const ComputationTreeBox &tree_box) {
+					return !is_dynamic_type<NoOpCn>(*tree_box.get_tree());
+				});
+				BasicBlock *next = nullptr;
+				if (last_it == tree_boxes.rend()) {
+					next = this->get_fallthrough_succ_nullable(dest);
+				} else if (last_it == tree_boxes.rbegin() && !std::any_of(
+					tree_boxes.begin(),
+					tree_boxes.end() - 1,
+					[](const ComputationTreeBox &tree_box) { return !is_dynamic_type<NoOpCn>(*tree_box.get_tree()); }
+				)) {
+					const BranchCn *branch_node = dynamic_cast<const BranchCn *>(last_it->get_tree().get());
+					if (branch_node && !branch_node->condition) {
+						next = branch_node->jmp_dest;
+					}
+				}
+				if (!next) {
+					break;
+				}
+				dest = next;
+			}
+			return dest;
+		}
+
+		bool is_cold(BasicBlock *block) const { return this->cold_blocks.count(block) > 0; }
+
+		BasicBlock *get_fallthrough_succ_nullable(BasicBlock *block) const {
+			auto it = this->fallthrough_succs.find(block);
+			return it == this->fallthrough_succs.end() ? nullptr : it->second;
+		}
+
+		// whether going from `block` to `succ` leaves the innermost loop
+		// that `block` is in
+		bool exits_loop(BasicBlock *block, BasicBlock *succ) const {
+			auto it = this->innermost_loops.find(block);
+			return it != this->innermost_loops.end() && it->second->blocks.count(succ) == 0;
+		}
+
+		bool is_back_edge(BasicBlock *block, BasicBlock *succ) const {
+			auto it = this->innermost_loops.find(block);
+			if (it == this->innermost_loops.end() || it->second->header != succ) {
+				return false;
+			}
+			const Vec<BasicBlock *> &latches = it->second->latches;
+			return std::find(latches.begin(), latches.end(), block) != latches.end();
+		}
+
+		// Guesses whether a conditional branch is taken, checking the
+		// heuristics in order of how much they are trusted. Returns none if
+		// none of them apply.
+		Opt<bool> predict_taken(BasicBlock *block, BasicBlock *taken, BasicBlock *not_taken) const {
+			if (this->is_cold(taken) != this->is_cold(not_taken)) {
+				return !this->is_cold(taken);
+			}
+			if (this->is_back_edge(block, taken) != this->is_back_edge(block, not_taken)) {
+				return this->is_back_edge(block, taken);
+			}
+			if (this->exits_loop(block, taken) != this->exits_loop(block, not_taken)) {
+				return !this->exits_loop(block, taken);
+			}
+			return {};
+		}
+
+		// The successor that should be laid out right after the block, if
+		// any. A conditional branch can only have its taken side fall
+		// through if its condition can be negated.
+		BasicBlock *get_preferred_succ_nullable(BasicBlock *block) const {
+			BasicBlock *fallthrough = this->get_fallthrough_succ_nullable(block);
+			BranchCn *branch_node = get_branch_nullable(*block);
+			if (!branch_node) {
+				return fallthrough;
+			}
+			if (!branch_node->condition) {
+				return branch_node->jmp_dest;
+			}
+			if (fallthrough && get_negatable_condition_nullable(*branch_node)) {
+				Opt<bool> taken = this->predict_taken(block, branch_node->jmp_dest, fallthrough);
+				if (taken && *taken) {
+					return branch_node->jmp_dest;
+				}
+			}
+			return fallthrough;
+		}
+
+		// Strings the blocks together into chains that follow the preferred
+		// successors, starting from the entry block, then from the other
+		// hot blocks in their original order, then from the cold ones. A
+		// chain never goes from a hot block into a cold one, so the cold
+		// blocks all end up at the end.
+		Vec<BasicBlock *> chain_blocks() const {
+			BasicBlock *entry_block = this->blocks.front().get();
+			Vec<BasicBlock *> seeds { entry_block };
+			for (const Uptr<BasicBlock> &block : this->blocks) {
+				if (block.get() != entry_block && !this->is_cold(block.get())) {
+					seeds.push_back(block.get());
+				}
+			}
+			for (const Uptr<BasicBlock> &block : this->blocks) {
+				if (block.get() != entry_block && this->is_cold(block.get())) {
+					seeds.push_back(block.get());
+				}
+			}
+			Vec<BasicBlock *> order;
+			Set<BasicBlock *> placed;
+			for (BasicBlock *seed : seeds) {
+				BasicBlock *block = seed;
+				while (block && placed.insert(block).second) {
+					order.push_back(block);
+					BasicBlock *next = this->get_preferred_succ_nullable(block);
+					if (!next || next == entry_block || (this->is_cold(next) && !this->is_cold(block))) {
+						break;
+					}
+					block = next;
+				}
+			}
+			return order;
+		}
+
+		// Gives the block a label if it doesn't have one, so that it can be
+		// jumped to.
+		void name_block(BasicBlock *block) {
+			if (block->get_name().size() == 0) {
+				block->mangle_name(code_gen::target_arch::make_generated_label_name(
+					"layout", this->l3_function.get_name(), std::to_string(this->num_generated_labels)
+				));
+				this->num_generated_labels += 1;
+			}
+		}
+
+		// jumps past the blocks that would only pass control along
+		ArenaUptr<ComputationNode> make_jump(BasicBlock *dest) {
+			dest = this->final_dests.at(dest);
+			this->name_block(dest);
+			return this->l3_function.get_node_arena().make<BranchCn>(dest, Opt<ArenaUptr<ComputationNode>>());
+		}
+
+		// Makes the branches agree with the new order: each block that
+		// used to fall through into a block that isn't next anymore jumps
+		// there instead, and the jumps to the next block are removed.
+		void fix_up_edges() {
+			for (size_t i = 0; i < this->blocks.size(); ++i) {
+				BasicBlock *block = this->blocks[i].get();
+				BasicBlock *next = i + 1 < this->blocks.size() ? this->blocks[i + 1].get() : nullptr;
+				BasicBlock *fallthrough = this->get_fallthrough_succ_nullable(block);
+				Vec<ComputationTreeBox> &tree_boxes = block->get_tree_boxes();
+				BranchCn *branch_node = get_branch_nullable(*block);
+				if (branch_node && !branch_node->condition) {
+					if (branch_node->jmp_dest == next) {
+						tree_boxes.pop_back();
+					}
+					continue;
+				}
+				if (!fallthrough || fallthrough == next) {
+					continue;
+				}
+				if (!branch_node) {
+					tree_boxes.emplace_back(this->make_jump(fallthrough));
+					continue;
+				}
+				if (branch_node->jmp_dest == next) {
+					if (BinaryCn *condition = get_negatable_condition_nullable(*branch_node)) {
+						BasicBlock *dest = this->final_dests.at(fallthrough);
+						condition->op = *negate_operator(condition->op);
+						this->name_block(dest);
+						branch_node->jmp_dest = dest;
+						continue;
+					}
+				}
+				// the conditional branch can only fall through, so the
+				// fallthrough goes to a new block that jumps to the right
+				// place
+				BasicBlock::Builder jump_builder;
+				Uptr<BasicBlock> jump_block = jump_builder.get_result(nullptr);
+				jump_block->get_tree_boxes().emplace_back(this->make_jump(fallthrough));
+				this->blocks.insert(this->blocks.begin() + i + 1, mv(jump_block));
+				i += 1;
+			}
+		}
+
+		// Replaces each jump to a small block that returns or jumps
+		// somewhere else with a copy of that block, which saves a jump.
+		void duplicate_small_blocks() {
+			Arena &arena = this->l3_function.get_node_arena();
+			for (size_t i = 0; i < this->blocks.size(); ++i) {
+				BasicBlock *block = this->blocks[i].get();
+				BranchCn *branch_node = get_branch_nullable(*block);
+				if (!branch_node || branch_node->condition || branch_node->jmp_dest == block) {
+					continue;
+				}
+				Opt<Vec<ArenaUptr<ComputationNode>>> clones = clone_small_block(*branch_node->jmp_dest, arena);
+				if (!clones) {
+					continue;
+				}
+				Vec<ComputationTreeBox> &tree_boxes = block->get_tree_boxes();
+				tree_boxes.pop_back();
+				for (ArenaUptr<ComputationNode> &clone : *clones) {
+					tree_boxes.emplace_back(mv(clone));
+				}
+				// the copy might end with a jump to the next block
+				BasicBlock *next = i + 1 < this->blocks.size() ? this->blocks[i + 1].get() : nullptr;
+				BranchCn *new_branch_node = get_branch_nullable(*block);
+				if (new_branch_node && !new_branch_node->condition && new_branch_node->jmp_dest == next) {
+					tree_boxes.pop_back();
+				}
+			}
+		}
+
+		// Removes the blocks that nothing goes to anymore, which happens to
+		// the blocks that every jump now has a copy of.
+		void remove_unused_blocks() {
+			BasicBlock::generate_succ_blocks(this->blocks);
+			BasicBlock::generate_pred_blocks(this->blocks);
+			Set<BasicBlock *> label_values;
+			for (Uptr<BasicBlock> &block : this->blocks) {
+				for (ComputationTreeBox &tree_box : block->get_tree_boxes()) {
+					collect_label_values(*tree_box.get_tree(), label_values);
+				}
+			}
+			size_t num_kept = 1; // the entry block always stays
+			for (size_t i = 1; i < this->blocks.size(); ++i) {
+				BasicBlock *block = this->blocks[i].get();
+				if (block->get_pred_blocks().empty() && label_values.count(block) == 0) {
+					this->l3_function.remove_block(mv(this->blocks[i]));
+					continue;
+				}
+				if (num_kept != i) {
+					this->blocks[num_kept] = mv(this->blocks[i]);
+				}
+				num_kept += 1;
+			}
+			this->blocks.erase(this->blocks.begin() + num_kept, this->blocks.end());
+		}
+	};
+
+	void lay_out_blocks(L3Function &l3_function) {
+		if (l3_function.get_blocks().empty()) {
+			return;
+		}
+		BlockLayout layout(l3_function);
+		layout.lay_out();
+	}
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include "program.h"
+
+namespace L3::program::analyze {
+	// at most how many trees (not counting no-ops) a block can have for a
+	// jump to it to be replaced with a copy of it
+	const int MAX_DUPLICATED_TREES = 3;
+
+	// Reorders the blocks of the function so that the likely successor of
+	// each block comes right after it, guessing which way each branch goes
+	// with static heuristics:
+	// - a block that calls a function that never returns (like
+	//   tensor-error) is cold, as is everything that only leads to or only
+	//   follows cold blocks
+	// - a branch back to a loop's header is taken, and one that leaves the
+	//   loop isn't
+	// The cold blocks go at the end of the function. A conditional branch
+	// whose comparison can be negated has it negated where that lets the
+	// taken side fall through, and a jump to a small block that ends in a
+	// return or a jump is replaced by a copy of that block.
+	// Works on merged or unmerged trees; the entry block stays first. The
+	// succ and pred blocks are regenerated, but not the data flow.
+	void lay_out_blocks(L3Function &l3_function);
+}
@@ -0,0 +1,176 @@
+#include "branch_simplification.h"
+#include "analyze_trees.h"
+#include "std_alias.h"
+
+namespace L3::program::analyze {
+	using namespace std_alias;
+
+	// whether the block only has no-ops (like its label)
+	bool is_empty(const BasicBlock &block) {
+		for (const ComputationTreeBox &tree_box : block.get_tree_boxes()) {
+			if (!is_dynamic_type<NoOpCn>(*tree_box.get_tree())) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	BranchCn *get_branch_nullable(BasicBlock &block) {
+		Vec<ComputationTreeBox> &tree_boxes = block.get_tree_boxes();
+		if (tree_boxes.empty()) {
+			return nullptr;
+		}
+		return dynamic_cast<BranchCn *>(tree_boxes.back().get_tree().get());
+	}
+
+	void collect_label_values(const ComputationNode &tree, Set<BasicBlock *> &label_values) {
+		if (const LabelCn *label_node = dynamic_cast<const LabelCn *>(&tree)) {
+			label_values.insert(label_node->jmp_dest);
+		} else if (const MoveCn *move_node = dynamic_cast<const MoveCn *>(&tree)) {
+			collect_label_values(*move_node->source, label_values);
+		} else if (const BinaryCn *bin_node = dynamic_cast<const BinaryCn *>(&tree)) {
+			collect_label_values(*bin_node->lhs, label_values);
+			collect_label_values(*bin_node->rhs, label_values);
+		} else if (const StoreCn *store_node = dynamic_cast<const StoreCn *>(&tree)) {
+			collect_label_values(*store_node->value, label_values);
+		} else if (const CallCn *call_node = dynamic_cast<const CallCn *>(&tree)) {
+			for (const ArenaUptr<ComputationNode> &argument : call_node->arguments) {
+				collect_label_values(*argument, label_values);
+			}
+		} else if (const ReturnCn *return_node = dynamic_cast<const ReturnCn *>(&tree)) {
+			if (return_node->value) {
+				collect_label_values(**return_node->value, label_values);
+			}
+		}
+	}
+
+	// Returns where a jump to `dest` ends up after going through the blocks
+	// that just jump or fall through somewhere else. Stops at a block whose
+	// fallthrough successor has no label to jump to, and at a cycle.
+	BasicBlock *get_final_dest(BasicBlock *dest, const Vec<Uptr<BasicBlock>> &blocks, const Map<BasicBlock *, size_t> &block_indices) {
+		Set<BasicBlock *> visited;
+		while (visited.insert(dest).second) {
+			if (is_empty(*dest)) {
+				size_t next_index = block_indices.at(dest) + 1;
+				if (next_index == blocks.size() || blocks[next_index]->get_name().size() == 0) {
+					break;
+				}
+				dest = blocks[next_index].get();
+				continue;
+			}
+			const Vec<ComputationTreeBox> &tree_boxes = dest->get_tree_boxes();
+			const BranchCn *branch_node = dynamic_cast<const BranchCn *>(tree_boxes.back().get_tree().get());
+			if (!branch_node || branch_node->condition) {
+				break;
+			}
+			bool only_branches = true;
+			for (size_t i = 0; i + 1 < tree_boxes.size(); ++i) {
+				if (!is_dynamic_type<NoOpCn>(*tree_boxes[i].get_tree())) {
+					only_branches = false;
+					break;
+				}
+			}
+			if (!only_branches) {
+				break;
+			}
+			dest = branch_node->jmp_dest;
+		}
+		return dest;
+	}
+
+	// Does one round of the simplifications. Returns whether anything
+	// changed.
+	bool simplify_branches_once(L3Function &l3_function) {
+		Vec<Uptr<BasicBlock>> &blocks = l3_function.get_blocks();
+		bool changed = false;
+
+		// thread the jumps through the blocks that don't do anything
+		Map<BasicBlock *, size_t> block_indices;
+		for (size_t i = 0; i < blocks.size(); ++i) {
+			block_indices.insert({ blocks[i].get(), i });
+		}
+		for (Uptr<BasicBlock> &block : blocks) {
+			if (BranchCn *branch_node = get_branch_nullable(*block)) {
+				BasicBlock *final_dest = get_final_dest(branch_node->jmp_dest, blocks, block_indices);
+				if (final_dest != branch_node->jmp_dest) {
+					branch_node->jmp_dest = final_dest;
+					changed = true;
+				}
+			}
+		}
+
+		// A branch to the next block goes there whether it's taken or not.
+		// The trees aren't merged, so a condition is just a variable or a
+		// number and can go away with the branch.
+		for (size_t i = 0; i + 1 < blocks.size(); ++i) {
+			BranchCn *branch_node = get_branch_nullable(*blocks[i]);
+			if (branch_node && branch_node->jmp_dest == blocks[i + 1].get()) {
+				blocks[i]->get_tree_boxes().pop_back();
+				changed = true;
+			}
+		}
+
+		// Remove the blocks that can't run, and the empty ones that are
+		// only ever fallen into (where the next block does the same thing).
+		// A label used as a value must stay in the L2 code, so its block is
+		// treated as reachable along with everything after it.
+		BasicBlock::generate_succ_blocks(blocks);
+		Set<BasicBlock *> label_values;
+		for (Uptr<BasicBlock> &block : blocks) {
+			for (ComputationTreeBox &tree_box : block->get_tree_boxes()) {
+				collect_label_values(*tree_box.get_tree(), label_values);
+			}
+		}
+		Vec<BasicBlock *> worklist(label_values.begin(), label_values.end());
+		worklist.push_back(blocks.front().get());
+		Set<BasicBlock *> reachable(worklist.begin(), worklist.end());
+		while (!worklist.empty()) {
+			BasicBlock *block = worklist.back();
+			worklist.pop_back();
+			for (BasicBlock *succ : block->get_succ_blocks()) {
+				if (reachable.insert(succ).second) {
+					worklist.push_back(succ);
+				}
+			}
+		}
+		Set<BasicBlock *> branch_targets;
+		for (Uptr<BasicBlock> &block : blocks) {
+			if (!reachable.count(block.get())) {
+				continue;
+			}
+			if (BranchCn *branch_node = get_branch_nullable(*block)) {
+				branch_targets.insert(branch_node->jmp_dest);
+			}
+		}
+		size_t num_kept = 1; // the entry block always stays
+		for (size_t i = 1; i < blocks.size(); ++i) {
+			BasicBlock *block = blocks[i].get();
+			bool is_removable = !reachable.count(block)
+				|| (is_empty(*block) && !branch_targets.count(block) && !label_values.count(block));
+			if (is_removable) {
+				l3_function.remove_block(mv(blocks[i]));
+				changed = true;
+				continue;
+			}
+			if (num_kept != i) {
+				blocks[num_kept] = mv(blocks[i]);
+			}
+			num_kept += 1;
+		}
+		blocks.erase(blocks.begin() + num_kept, blocks.end());
+		return changed;
+	}
+
+	int simplify_branches(L3Function &l3_function) {
+		Vec<Uptr<BasicBlock>> &blocks = l3_function.get_blocks();
+		if (blocks.empty()) {
+			return 0;
+		}
+		// Each round removes a branch or a block or points a branch
+		// further along, so this ends.
+		while (simplify_branches_once(l3_function)) {}
+		BasicBlock::generate_succ_blocks(blocks);
+		BasicBlock::generate_pred_blocks(blocks);
+		return generate_data_flow(l3_function);
+	}
+}
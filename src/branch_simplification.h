@@ -0,0 +1,25 @@
+#pragma once
+#include "program.h"
+
+namespace L3::program::analyze {
+	// Assumes that data flow has already been generated for the function and
+	// that the trees haven't been merged yet.
+	// Cleans up the control flow graph until nothing changes:
+	// - a branch to a block that does nothing but jump or fall through
+	//   somewhere else goes straight there instead
+	// - a branch to the block laid out right after its own is removed
+	// - the blocks that can't be reached from the entry, and the empty
+	//   blocks that nothing branches to, are removed
+	// The successors of the blocks are regenerated from the trees, so the
+	// edges that earlier passes left stale are gone too, and so is the data
+	// flow; returns the number of block updates that took.
+	int simplify_branches(L3Function &l3_function);
+
+	// Returns the branch that the block ends with, if it has one.
+	BranchCn *get_branch_nullable(BasicBlock &block);
+
+	// Adds the blocks whose labels are used as values in the tree. Those
+	// blocks must stay in the function even if nothing jumps to them, since
+	// the L2 code refers to their labels.
+	void collect_label_values(const ComputationNode &tree, Set<BasicBlock *> &label_values);
+}
@@ -7,45 +7,45 @@ namespace L3::code_gen {
 	using namespace std_alias;
 	using namespace L3::program;
 
-	void generate_l3_function_code(const L3Function &l3_function, std::ostream &o) {
-		// function header
-		o << "\t(@" << l3_function.get_name()
-			<< " " << l3_function.get_parameter_vars().size() << "\n";
+	l2::Function generate_l2_function(const L3Function &l3_function, tiles::TilingStrategy tiling_strategy, timing::PhaseTimes *times_nullable) {
+		l2::Function l2_function(l3_function);
+		Vec<l2::Instruction> &out = l2_function.instructions;
 
 		// assign parameter registers to variables
 		const Vec<Variable *> &parameter_vars = l3_function.get_parameter_vars();
 		for (int i = 0; i < parameter_vars.size(); ++i) {
-			o << "\t\t" << target_arch::get_argument_loading_instruction(
+			out.push_back(target_arch::get_argument_loading_instruction(
 				target_arch::to_l2_expr(parameter_vars[i]),
 				i,
 				parameter_vars.size()
-			) << "\n";
+			));
 		}
 
-		// print each block
+		// generate each block
+		tiles::FunctionContext ctx(l3_function);
 		for (const Uptr<BasicBlock> &block : l3_function.get_blocks()) {
 			if (block->get_name().size() > 0) {
-				o << "\t\t:" << block->get_name() << "\n";
+				out.push_back(l2::Instruction::make_label(target_arch::to_l2_expr(block.get())));
 			}
-			Vec<Uptr<tiles::Tile>> tiles = tiles::tile_trees(block->get_tree_boxes());
+			Vec<Uptr<tiles::Tile>> tiles;
+			{
+				timing::ScopedPhaseTimer timer(times_nullable, timing::Phase::tile_trees);
+				tiles = tiles::tile_trees(block->get_tree_boxes(), tiling_strategy);
+			}
+			timing::ScopedPhaseTimer timer(times_nullable, timing::Phase::emit);
 			for (const Uptr<tiles::Tile> &tile : tiles) {
-				for (const std::string &inst : tile->to_l2_instructions()) {
-					o << "\t\t" << inst << "\n";
-				}
+				tile->to_l2_instructions(ctx, out);
 			}
 		}
 
-		// close
-		o << "\t)\n";
+		return l2_function;
 	}
 
-	void generate_program_code(Program &program, std::ostream &o) {
-		target_arch::mangle_label_names(program);
-
+	void generate_program_header(const Program &program, std::ostream &o) {
 		o << "(@" << (*program.get_main_function_ref().get_referent())->get_name() << "\n";
-		for (const Uptr<L3Function> &function : program.get_l3_functions()) {
-			generate_l3_function_code(*function, o);
-		}
+	}
+
+	void generate_program_footer(std::ostream &o) {
 		o << ")\n";
 	}
-}
\ No newline at end of file
+}
@@ -1,15 +1,28 @@
 #pragma once
 #include "program.h"
+#include "std_alias.h"
+#include "timing.h"
+#include "l2.h"
+#include "tiles.h"
+#include <string>
 #include <iostream>
 
 namespace L3::code_gen {
-	// TODO for the code generation, it'd be really nice if we just mapped to
-	// a memory representation of the L2 code, and then did a to_string-ish
-	// operation on that. That would let us avoid most of the problems with
-	// conflicting names and whatnot because the memory representation doesn't
-	// use names, so we can just assign them at the very end.
+	using namespace std_alias;
 
-	void generate_l3_function_code(const L3::program::L3Function &l3_function, std::ostream &o);
+	// Tiles every block of the function into L2 instructions, which can then
+	// be printed with l2::print_function(). If `times_nullable` is given, the
+	// time spent tiling and emitting is added to it.
+	l2::Function generate_l2_function(
+		const L3::program::L3Function &l3_function,
+		tiles::TilingStrategy tiling_strategy,
+		timing::PhaseTimes *times_nullable = nullptr
+	);
 
-	void generate_program_code(L3::program::Program &program, std::ostream &o);
+	// The code of each function goes between the header and the footer of
+	// the program, in the same order as Program::get_l3_functions(). The
+	// label names must have been mangled before any of the function code
+	// was generated.
+	void generate_program_header(const L3::program::Program &program, std::ostream &o);
+	void generate_program_footer(std::ostream &o);
 }
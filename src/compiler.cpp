@@ -4,6 +4,8 @@
 #include "tiles.h"
 #include "analyze_trees.h"
 #include "code_gen.h"
+#include "timing.h"
+#include "pipeline.h"
 #include <string>
 #include <vector>
 #include <utility>
@@ -22,11 +24,38 @@
 
 using namespace std_alias;
 
+// how many functions the -T report lists
+const int NUM_SLOWEST_FUNCTIONS_REPORTED = 10;
+
 void print_help(char *progName) {
-	std::cerr << "Usage: " << progName << " [-v] [-g 0|1] [-O 0|1|2] [-p] SOURCE" << std::endl;
+	std::cerr << "Usage: " << progName << " [-v] [-g 0|1] [-O 0|1|2] [-f [no-]PASS]... [-p] [-j N] [-T] SOURCE" << std::endl;
 	return;
 }
 
+// Prints how many block updates the liveness analysis of each function took
+// to reach a fixed point. `function_stats` is parallel to the functions.
+void print_liveness_report(const L3::program::Program &program, const Vec<L3::pipeline::FunctionStats> &function_stats) {
+	const Vec<Uptr<L3::program::L3Function>> &l3_functions = program.get_l3_functions();
+	for (size_t i = 0; i < l3_functions.size(); ++i) {
+		std::cerr << "liveness @" << l3_functions[i]->get_name() << ": "
+			<< function_stats[i].num_liveness_iterations << " block updates for "
+			<< l3_functions[i]->get_blocks().size() << " blocks\n";
+	}
+}
+
+// Prints how many rewrites each peephole rule made over the whole program.
+void print_peephole_report(const Vec<L3::pipeline::FunctionStats> &function_stats) {
+	using namespace L3::code_gen::peephole;
+	RewriteCounts total;
+	for (const L3::pipeline::FunctionStats &stats : function_stats) {
+		total += stats.peephole_rewrites;
+	}
+	for (int i = 0; i < NUM_RULES; ++i) {
+		Rule rule = static_cast<Rule>(i);
+		std::cerr << "peephole " << get_rule_name(rule) << ": " << total[rule] << " rewrites\n";
+	}
+}
+
 int main(
 	int argc,
 	char **argv
@@ -34,7 +63,10 @@ int main(
 	bool enable_code_generator = true;
 	bool output_parse_tree = false;
 	bool verbose = false;
+	bool report_times = false;
 	int32_t optimizationLevel = 3;
+	Vec<std::string> pass_flags;
+	int num_jobs = 1;
 
 	// Check the compiler arguments.
 	if (argc < 2) {
@@ -44,11 +76,14 @@ int main(
 
 	int32_t option;
 	int64_t functionNumber = -1;
-	while ((option = getopt(argc, argv, "vg:O:p")) != -1) {
+	while ((option = getopt(argc, argv, "vg:O:f:pj:T")) != -1) {
 		switch (option) {
 			case 'O':
 				optimizationLevel = strtoul(optarg, NULL, 0);
 				break;
+			case 'f':
+				pass_flags.push_back(optarg);
+				break;
 			case 'g':
 				enable_code_generator = (strtoul(optarg, NULL, 0) == 0) ? false : true;
 				break;
@@ -58,27 +93,78 @@ int main(
 			case 'p':
 				output_parse_tree = true;
 				break;
+			case 'T':
+				report_times = true;
+				break;
+			case 'j':
+				num_jobs = strtoul(optarg, NULL, 0);
+				if (num_jobs < 1) {
+					print_help(argv[0]);
+					return 1;
+				}
+				break;
 			default:
 				print_help(argv[0]);
 				return 1;
 		}
 	}
 
+	// the -f flags override the -O level no matter the order they're given in
+	L3::pipeline::PassConfig pass_config(optimizationLevel);
+	for (const std::string &pass_flag : pass_flags) {
+		if (!pass_config.apply_flag(pass_flag)) {
+			std::cerr << "unknown pass \"" << pass_flag << "\"; the passes are: "
+				<< L3::pipeline::PassConfig::get_pass_names() << std::endl;
+			return 1;
+		}
+	}
+
+	using L3::timing::Phase;
+	using L3::timing::ScopedPhaseTimer;
+	L3::timing::Stopwatch compile_stopwatch;
+	L3::timing::PhaseTimes program_times;
+	L3::timing::PhaseTimes *program_times_nullable = report_times ? &program_times : nullptr;
+
 	// Parse the input file.
-	Uptr<L3::program::Program> p = L3::parser::parse_file(
-		argv[optind],
-		output_parse_tree ? std::make_optional("parse_tree.dot") : Opt<std::string>()
-	);
+	Uptr<L3::program::Program> p;
+	{
+		ScopedPhaseTimer timer(program_times_nullable, Phase::parse);
+		p = L3::parser::parse_file(
+			argv[optind],
+			output_parse_tree ? std::make_optional("parse_tree.dot") : Opt<std::string>()
+		);
+	}
 
-	if (enable_code_generator) {
-		L3::program::analyze::generate_data_flow(*p);
-		L3::program::analyze::merge_trees(*p);
+	Vec<Uptr<L3::program::L3Function>> &l3_functions = p->get_l3_functions();
+	Vec<L3::timing::PhaseTimes> function_times(report_times ? l3_functions.size() : 0);
+	Vec<L3::timing::PhaseTimes> *function_times_nullable = report_times ? &function_times : nullptr;
 
+	if (enable_code_generator) {
 		std::ofstream o;
 		o.open("prog.L2");
-		L3::code_gen::generate_program_code(*p, o);
+		Vec<L3::pipeline::FunctionStats> function_stats;
+		L3::pipeline::compile_program(*p, pass_config, num_jobs, o, function_stats, function_times_nullable);
+		if (verbose) {
+			print_liveness_report(*p, function_stats);
+			print_peephole_report(function_stats);
+		}
 		o.close();
 	}
 
+	if (report_times) {
+		Vec<std::string> function_names;
+		for (const Uptr<L3::program::L3Function> &l3_function : l3_functions) {
+			function_names.push_back(l3_function->get_name());
+		}
+		L3::timing::print_report(
+			std::cerr,
+			program_times,
+			function_names,
+			function_times,
+			compile_stopwatch.get_elapsed(),
+			NUM_SLOWEST_FUNCTIONS_REPORTED
+		);
+	}
+
 	return 0;
 }
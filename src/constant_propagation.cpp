@@ -0,0 +1,218 @@
+#include "constant_propagation.h"
+#include "analyze_trees.h"
+#include "dead_code_elimination.h"
+#include "std_alias.h"
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+
+namespace L3::program::analyze {
+	using namespace std_alias;
+
+	// the variables known to hold a constant at some point of a block
+	using ConstantMap = Map<Variable *, int64_t>;
+
+	// Evaluates the operator the same way the L2 instruction for it would on
+	// 64-bit integers.
+	int64_t evaluate(Operator op, int64_t lhs, int64_t rhs) {
+		// unsigned arithmetic wraps around instead of overflowing
+		uint64_t lhs_bits = static_cast<uint64_t>(lhs);
+		uint64_t rhs_bits = static_cast<uint64_t>(rhs);
+		switch (op) {
+			case Operator::lt: return lhs < rhs;
+			case Operator::le: return lhs <= rhs;
+			case Operator::eq: return lhs == rhs;
+			case Operator::ge: return lhs >= rhs;
+			case Operator::gt: return lhs > rhs;
+			case Operator::plus: return static_cast<int64_t>(lhs_bits + rhs_bits);
+			case Operator::minus: return static_cast<int64_t>(lhs_bits - rhs_bits);
+			case Operator::times: return static_cast<int64_t>(lhs_bits * rhs_bits);
+			case Operator::bitwise_and: return lhs & rhs;
+			// the shift instructions only use the low 6 bits of the amount,
+			// and the right shift is arithmetic
+			case Operator::lshift: return static_cast<int64_t>(lhs_bits << (rhs_bits & 63));
+			case Operator::rshift: return lhs >> (rhs_bits & 63);
+		}
+		std::cerr << "Error: can't evaluate the operator " << to_string(op) << "\n";
+		exit(1);
+	}
+
+	// Walks the tree in the order it is evaluated, keeping `constants` up to
+	// date with the variables that the tree writes, and returns the value of
+	// the tree if it is a known constant.
+	// If `arena_nullable` is given, the tree is also rewritten: reads of
+	// constant variables become number literals and constant computations
+	// are replaced by their result. `may_become_number` is false where L2
+	// needs the node to be a variable (e.g. an address), in which case a
+	// node without a destination is never turned into a number.
+	Opt<int64_t> fold_tree(
+		ArenaUptr<ComputationNode> &tree,
+		ConstantMap &constants,
+		Arena *arena_nullable,
+		bool may_become_number
+	) {
+		Opt<int64_t> value;
+		if (NumberCn *number_node = dynamic_cast<NumberCn *>(tree.get())) {
+			value = number_node->value;
+		} else if (VariableCn *var_node = dynamic_cast<VariableCn *>(tree.get())) {
+			// the "destination" of a VariableCn is the variable it reads, so
+			// there's nothing written to record
+			auto it = constants.find(*var_node->destination);
+			if (it == constants.end()) {
+				return {};
+			}
+			if (arena_nullable && may_become_number) {
+				tree = arena_nullable->make<NumberCn>(it->second);
+			}
+			return it->second;
+		} else if (MoveCn *move_node = dynamic_cast<MoveCn *>(tree.get())) {
+			value = fold_tree(move_node->source, constants, arena_nullable, true);
+		} else if (BinaryCn *bin_node = dynamic_cast<BinaryCn *>(tree.get())) {
+			Opt<int64_t> lhs = fold_tree(bin_node->lhs, constants, arena_nullable, true);
+			Opt<int64_t> rhs = fold_tree(bin_node->rhs, constants, arena_nullable, true);
+			if (lhs && rhs) {
+				value = evaluate(bin_node->op, *lhs, *rhs);
+			}
+		} else if (LoadCn *load_node = dynamic_cast<LoadCn *>(tree.get())) {
+			fold_tree(load_node->address, constants, arena_nullable, false);
+		} else if (StoreCn *store_node = dynamic_cast<StoreCn *>(tree.get())) {
+			fold_tree(store_node->address, constants, arena_nullable, false);
+			fold_tree(store_node->value, constants, arena_nullable, true);
+		} else if (CallCn *call_node = dynamic_cast<CallCn *>(tree.get())) {
+			fold_tree(call_node->callee, constants, arena_nullable, false);
+			for (ArenaUptr<ComputationNode> &argument : call_node->arguments) {
+				fold_tree(argument, constants, arena_nullable, true);
+			}
+		} else if (BranchCn *branch_node = dynamic_cast<BranchCn *>(tree.get())) {
+			if (branch_node->condition) {
+				Opt<int64_t> condition = fold_tree(*branch_node->condition, constants, arena_nullable, true);
+				if (condition && arena_nullable) {
+					// a branch is taken when its condition is 1
+					if (*condition == 1) {
+						branch_node->condition.reset();
+					} else {
+						tree = arena_nullable->make<NoOpCn>();
+					}
+				}
+			}
+		} else if (ReturnCn *return_node = dynamic_cast<ReturnCn *>(tree.get())) {
+			if (return_node->value) {
+				fold_tree(*return_node->value, constants, arena_nullable, true);
+			}
+		}
+		// NoOpCn, FunctionCn, and LabelCn have nothing to fold
+
+		if (tree->destination) {
+			if (value) {
+				constants.insert_or_assign(*tree->destination, *value);
+			} else {
+				constants.erase(*tree->destination);
+			}
+		}
+
+		if (value
+			&& arena_nullable
+			&& !is_dynamic_type<NumberCn>(*tree)
+			&& (tree->destination || may_become_number))
+		{
+			Opt<Variable *> destination = tree->destination;
+			tree = arena_nullable->make<NumberCn>(*value);
+			tree->destination = destination;
+		}
+		return value;
+	}
+
+	int propagate_constants(L3Function &l3_function) {
+		Vec<Uptr<BasicBlock>> &blocks = l3_function.get_blocks();
+		if (blocks.empty()) {
+			return 0;
+		}
+		BasicBlock *entry_block = blocks.front().get();
+
+		// The constants at the end of each block. A block that hasn't been
+		// visited yet has an empty optional, which the meet below skips over
+		// so that constants can flow around loops; once visited, the maps
+		// only ever shrink, so the iteration terminates.
+		Map<BasicBlock *, Opt<ConstantMap>> out_constants;
+		auto get_in_constants = [&](BasicBlock *block) -> Opt<ConstantMap> {
+			Opt<ConstantMap> result;
+			if (block == entry_block) {
+				// nothing is known about the parameters
+				result = ConstantMap();
+			}
+			for (BasicBlock *pred : block->get_pred_blocks()) {
+				const Opt<ConstantMap> &pred_constants = out_constants[pred];
+				if (!pred_constants) {
+					continue;
+				}
+				if (!result) {
+					result = *pred_constants;
+					continue;
+				}
+				// keep only the constants that every predecessor agrees on
+				for (auto it = result->begin(); it != result->end();) {
+					auto pred_it = pred_constants->find(it->first);
+					if (pred_it == pred_constants->end() || pred_it->second != it->second) {
+						it = result->erase(it);
+					} else {
+						++it;
+					}
+				}
+			}
+			if (result) {
+				// only the variables that are live into the block matter
+				const VarSet &in_set = block->get_in_set();
+				for (auto it = result->begin(); it != result->end();) {
+					if (!in_set.contains(it->first)) {
+						it = result->erase(it);
+					} else {
+						++it;
+					}
+				}
+			}
+			return result;
+		};
+
+		// visit the blocks in reverse postorder so that, apart from back
+		// edges, a block is visited after its predecessors
+		Vec<BasicBlock *> order = get_postorder(l3_function);
+		std::reverse(order.begin(), order.end());
+		bool changed = true;
+		while (changed) {
+			changed = false;
+			for (BasicBlock *block : order) {
+				Opt<ConstantMap> constants = get_in_constants(block);
+				if (!constants) {
+					continue; // not reachable through the blocks visited so far
+				}
+				for (ComputationTreeBox &tree_box : block->get_tree_boxes()) {
+					fold_tree(tree_box.get_tree(), *constants, nullptr, true);
+				}
+				Opt<ConstantMap> &block_out_constants = out_constants[block];
+				if (!block_out_constants || *block_out_constants != *constants) {
+					block_out_constants = mv(constants);
+					changed = true;
+				}
+			}
+		}
+
+		// rewrite the trees with the constants found
+		Arena &arena = l3_function.get_node_arena();
+		for (Uptr<BasicBlock> &block : blocks) {
+			ConstantMap constants = get_in_constants(block.get()).value_or(ConstantMap());
+			for (ComputationTreeBox &tree_box : block->get_tree_boxes()) {
+				fold_tree(tree_box.get_tree(), constants, &arena, true);
+			}
+		}
+
+		// the folded trees read fewer variables, so liveness must be redone
+		// before the assignments that are no longer read can be found.
+		// Removing those can only leave the liveness overly conservative,
+		// which dead code elimination cleans up if it's enabled.
+		int num_iterations = generate_data_flow(l3_function);
+		for (Uptr<BasicBlock> &block : blocks) {
+			remove_dead_trees(*block);
+		}
+		return num_iterations;
+	}
+}
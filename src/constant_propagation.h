@@ -0,0 +1,15 @@
+#pragma once
+#include "program.h"
+
+namespace L3::program::analyze {
+	// Assumes that data flow has already been generated for the function.
+	// Finds the variables that hold a known constant at each point of the
+	// function, both within a block and across blocks, and replaces the reads
+	// of those variables with the constant. Operations whose operands all
+	// become constant are folded into their result, branches on a constant
+	// condition become unconditional or disappear, and the trees that are no
+	// longer read are removed.
+	// The data flow is regenerated for the new trees; returns the number of
+	// block updates that took.
+	int propagate_constants(L3Function &l3_function);
+}
@@ -0,0 +1,83 @@
+#include "dead_code_elimination.h"
+#include "analyze_trees.h"
+#include "std_alias.h"
+
+namespace L3::program::analyze {
+	using namespace std_alias;
+
+	// whether evaluating the tree does anything besides writing variables
+	bool has_side_effects(const ComputationNode &tree) {
+		if (is_dynamic_type<CallCn, StoreCn>(tree)) {
+			return true;
+		}
+		if (const MoveCn *move_node = dynamic_cast<const MoveCn *>(&tree)) {
+			return has_side_effects(*move_node->source);
+		}
+		if (const BinaryCn *bin_node = dynamic_cast<const BinaryCn *>(&tree)) {
+			return has_side_effects(*bin_node->lhs) || has_side_effects(*bin_node->rhs);
+		}
+		if (const LoadCn *load_node = dynamic_cast<const LoadCn *>(&tree)) {
+			return has_side_effects(*load_node->address);
+		}
+		// branches and returns never have a destination, so they are never
+		// candidates for removal anyway
+		return false;
+	}
+
+	int remove_dead_trees(BasicBlock &block) {
+		Vec<ComputationTreeBox> &tree_boxes = block.get_tree_boxes();
+		Vec<bool> is_dead(tree_boxes.size(), false);
+		int num_dead = 0;
+		VarSet live = block.get_out_set();
+		for (size_t i = tree_boxes.size(); i-- > 0;) {
+			const ComputationTreeBox &tree_box = tree_boxes[i];
+			Opt<Variable *> var_written = tree_box.get_var_written();
+			if (var_written
+				&& !live.contains(*var_written)
+				&& !has_side_effects(*tree_box.get_tree()))
+			{
+				// the tree's reads don't make anything live
+				is_dead[i] = true;
+				num_dead += 1;
+				continue;
+			}
+			if (var_written) {
+				live.erase(*var_written);
+			}
+			for (Variable *var : tree_box.get_variables_read()) {
+				live.insert(var);
+			}
+		}
+		if (num_dead == 0) {
+			return 0;
+		}
+
+		size_t num_kept = 0;
+		for (size_t i = 0; i < tree_boxes.size(); ++i) {
+			if (!is_dead[i]) {
+				if (num_kept != i) {
+					tree_boxes[num_kept] = mv(tree_boxes[i]);
+				}
+				num_kept += 1;
+			}
+		}
+		tree_boxes.erase(tree_boxes.begin() + num_kept, tree_boxes.end());
+		return num_dead;
+	}
+
+	int eliminate_dead_code(L3Function &l3_function) {
+		// Removing a tree can only make the variables it read dead in the
+		// blocks before it, so keep going until a sweep removes nothing.
+		int num_iterations = 0;
+		while (true) {
+			int num_removed = 0;
+			for (Uptr<BasicBlock> &block : l3_function.get_blocks()) {
+				num_removed += remove_dead_trees(*block);
+			}
+			if (num_removed == 0) {
+				return num_iterations;
+			}
+			num_iterations += generate_data_flow(l3_function);
+		}
+	}
+}
@@ -0,0 +1,17 @@
+#pragma once
+#include "program.h"
+
+namespace L3::program::analyze {
+	// Removes the trees of the block that write a variable which isn't read
+	// afterwards and have no other effect (i.e. contain no call or store),
+	// walking backwards from the block's out set so that chains of dead
+	// trees within the block all go at once. Assumes the data flow of the
+	// block is up to date. Returns the number of trees removed.
+	int remove_dead_trees(BasicBlock &block);
+
+	// Assumes that data flow has already been generated for the function.
+	// Removes dead trees from every block, redoing the liveness analysis
+	// until no more trees die, so the data flow is up to date afterwards.
+	// Returns the number of block updates the liveness analysis took.
+	int eliminate_dead_code(L3Function &l3_function);
+}
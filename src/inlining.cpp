@@ -0,0 +1,346 @@
+#include "inlining.h"
+#include "target_arch.h"
+#include "std_alias.h"
+#include <iterator>
+#include <string>
+
+namespace L3::program::analyze {
+	using namespace std_alias;
+
+	// the L3 functions that a function's code refers to
+	struct FunctionRefs {
+		Set<const L3Function *> called; // called by name
+		Set<const L3Function *> address_taken; // used as a value, which might be called later
+		bool has_indirect_call;
+
+		FunctionRefs() : has_indirect_call { false } {}
+	};
+
+	void collect_function_refs(const ComputationNode &tree, FunctionRefs &refs) {
+		if (const FunctionCn *function_node = dynamic_cast<const FunctionCn *>(&tree)) {
+			if (const L3Function *l3_function = dynamic_cast<const L3Function *>(function_node->function)) {
+				refs.address_taken.insert(l3_function);
+			}
+		} else if (const MoveCn *move_node = dynamic_cast<const MoveCn *>(&tree)) {
+			collect_function_refs(*move_node->source, refs);
+		} else if (const BinaryCn *bin_node = dynamic_cast<const BinaryCn *>(&tree)) {
+			collect_function_refs(*bin_node->lhs, refs);
+			collect_function_refs(*bin_node->rhs, refs);
+		} else if (const LoadCn *load_node = dynamic_cast<const LoadCn *>(&tree)) {
+			collect_function_refs(*load_node->address, refs);
+		} else if (const StoreCn *store_node = dynamic_cast<const StoreCn *>(&tree)) {
+			collect_function_refs(*store_node->address, refs);
+			collect_function_refs(*store_node->value, refs);
+		} else if (const CallCn *call_node = dynamic_cast<const CallCn *>(&tree)) {
+			const FunctionCn *callee_node = dynamic_cast<const FunctionCn *>(call_node->callee.get());
+			if (!callee_node) {
+				refs.has_indirect_call = true;
+				collect_function_refs(*call_node->callee, refs);
+			} else if (const L3Function *l3_function = dynamic_cast<const L3Function *>(callee_node->function)) {
+				refs.called.insert(l3_function);
+			}
+			for (const ArenaUptr<ComputationNode> &argument : call_node->arguments) {
+				collect_function_refs(*argument, refs);
+			}
+		} else if (const BranchCn *branch_node = dynamic_cast<const BranchCn *>(&tree)) {
+			if (branch_node->condition) {
+				collect_function_refs(**branch_node->condition, refs);
+			}
+		} else if (const ReturnCn *return_node = dynamic_cast<const ReturnCn *>(&tree)) {
+			if (return_node->value) {
+				collect_function_refs(**return_node->value, refs);
+			}
+		}
+	}
+
+	InlineCandidates::InlineCandidates(const Program &program) {
+		// The trees of the functions haven't been generated yet, so make
+		// throwaway ones to see what each function refers to.
+		Arena scratch_arena;
+		Map<const L3Function *, FunctionRefs> function_refs;
+		Set<const L3Function *> address_taken;
+		for (const Uptr<L3Function> &l3_function : program.get_l3_functions()) {
+			FunctionRefs &refs = function_refs[l3_function.get()];
+			for (const Uptr<BasicBlock> &block : l3_function->get_blocks()) {
+				for (const Uptr<Instruction> &inst : block->get_raw_instructions()) {
+					collect_function_refs(*inst->to_computation_tree(scratch_arena), refs);
+				}
+			}
+			address_taken.insert(refs.address_taken.begin(), refs.address_taken.end());
+		}
+
+		// an indirect call might go to any function whose address is taken
+		Map<const L3Function *, Set<const L3Function *>> callees;
+		for (auto &[l3_function, refs] : function_refs) {
+			Set<const L3Function *> &function_callees = callees[l3_function];
+			function_callees = refs.called;
+			if (refs.has_indirect_call) {
+				function_callees.insert(address_taken.begin(), address_taken.end());
+			}
+		}
+
+		for (const Uptr<L3Function> &l3_function : program.get_l3_functions()) {
+			int num_instructions = 0;
+			for (const Uptr<BasicBlock> &block : l3_function->get_blocks()) {
+				for (const Uptr<Instruction> &inst : block->get_raw_instructions()) {
+					if (!dynamic_cast<const InstructionLabel *>(inst.get())) {
+						num_instructions += 1;
+					}
+				}
+			}
+			if (num_instructions > MAX_INLINED_INSTRUCTIONS) {
+				continue;
+			}
+
+			// a function that can reach itself through calls would be
+			// inlined into itself forever
+			const Set<const L3Function *> &function_callees = callees[l3_function.get()];
+			Vec<const L3Function *> worklist(function_callees.begin(), function_callees.end());
+			Set<const L3Function *> visited;
+			bool is_recursive = false;
+			while (!worklist.empty()) {
+				const L3Function *callee = worklist.back();
+				worklist.pop_back();
+				if (callee == l3_function.get()) {
+					is_recursive = true;
+					break;
+				}
+				if (visited.insert(callee).second) {
+					const Set<const L3Function *> &next_callees = callees[callee];
+					worklist.insert(worklist.end(), next_callees.begin(), next_callees.end());
+				}
+			}
+			if (is_recursive) {
+				continue;
+			}
+
+			Vec<const BasicBlock *> blocks;
+			for (const Uptr<BasicBlock> &block : l3_function->get_blocks()) {
+				blocks.push_back(block.get());
+			}
+			this->candidate_blocks.insert({ l3_function.get(), mv(blocks) });
+		}
+	}
+
+	Opt<const Vec<const BasicBlock *> *> InlineCandidates::get_blocks(const Function *function) const {
+		const L3Function *l3_function = dynamic_cast<const L3Function *>(function);
+		if (!l3_function) {
+			return {};
+		}
+		auto it = this->candidate_blocks.find(l3_function);
+		if (it == this->candidate_blocks.end()) {
+			return {};
+		}
+		return &it->second;
+	}
+
+	// Makes the copy of a callee's blocks for a single inlined call.
+	class CalleeCopier {
+		L3Function &caller;
+		int inline_index; // unique among the calls inlined into the caller
+		Map<const Variable *, Variable *> var_copies;
+		Map<const BasicBlock *, BasicBlock *> block_copies;
+
+		public:
+
+		CalleeCopier(L3Function &caller, int inline_index) :
+			caller { caller },
+			inline_index { inline_index }
+		{}
+
+		// The names start with a digit, which an L3 variable's name can't.
+		Variable *get_var_copy(const Variable *var) {
+			auto [it, inserted] = this->var_copies.insert({ var, nullptr });
+			if (inserted) {
+				it->second = this->caller.add_variable(std::to_string(this->inline_index) + "_" + var->get_name());
+			}
+			return it->second;
+		}
+
+		// the inline index keeps the labels of each inlined call apart
+		std::string get_label_name(const std::string &suffix) const {
+			return code_gen::target_arch::make_generated_label_name(
+				"inline", this->caller.get_name(), std::to_string(this->inline_index) + "_" + suffix
+			);
+		}
+
+		// Returns the copies of the callee's blocks in the same order, with
+		// each return turned into a move into `call_destination` and a jump
+		// to `continuation`.
+		Vec<Uptr<BasicBlock>> copy_blocks(
+			const Vec<const BasicBlock *> &callee_blocks,
+			Opt<Variable *> call_destination,
+			BasicBlock *continuation
+		) {
+			// every copy must exist before the branches to them are copied
+			Vec<Uptr<BasicBlock>> copies;
+			for (size_t i = 0; i < callee_blocks.size(); ++i) {
+				// the passes on the callee may name its blocks while this
+				// runs, so whether a block has a label comes from its
+				// instructions
+				BasicBlock::Builder builder;
+				const Vec<Uptr<Instruction>> &insts = callee_blocks[i]->get_raw_instructions();
+				if (!insts.empty() && dynamic_cast<const InstructionLabel *>(insts.front().get())) {
+					builder.add_next_instruction(mkuptr<InstructionLabel>(
+						Symbol::intern(this->get_label_name(std::to_string(i)))
+					));
+				}
+				copies.push_back(builder.get_result(nullptr));
+				this->block_copies.insert({ callee_blocks[i], copies.back().get() });
+			}
+
+			Arena &arena = this->caller.get_node_arena();
+			for (size_t i = 0; i < callee_blocks.size(); ++i) {
+				Vec<ComputationTreeBox> &tree_boxes = copies[i]->get_tree_boxes();
+				for (const Uptr<Instruction> &inst : callee_blocks[i]->get_raw_instructions()) {
+					if (dynamic_cast<const InstructionLabel *>(inst.get())) {
+						continue; // the copy has its own label
+					}
+					ArenaUptr<ComputationNode> tree = inst->to_computation_tree(arena);
+					this->rename(*tree);
+					if (ReturnCn *return_node = dynamic_cast<ReturnCn *>(tree.get())) {
+						if (return_node->value && call_destination) {
+							tree_boxes.emplace_back(arena.make<MoveCn>(call_destination, mv(*return_node->value)));
+						}
+						tree_boxes.emplace_back(arena.make<BranchCn>(continuation, Opt<ArenaUptr<ComputationNode>>()));
+					} else {
+						tree_boxes.emplace_back(mv(tree));
+					}
+				}
+			}
+			return copies;
+		}
+
+		private:
+
+		// makes a tree of the callee refer to the copies of its variables
+		// and blocks
+		void rename(ComputationNode &node) {
+			if (node.destination) {
+				node.destination = this->get_var_copy(*node.destination);
+			}
+			if (MoveCn *move_node = dynamic_cast<MoveCn *>(&node)) {
+				this->rename(*move_node->source);
+			} else if (BinaryCn *bin_node = dynamic_cast<BinaryCn *>(&node)) {
+				this->rename(*bin_node->lhs);
+				this->rename(*bin_node->rhs);
+			} else if (LoadCn *load_node = dynamic_cast<LoadCn *>(&node)) {
+				this->rename(*load_node->address);
+			} else if (StoreCn *store_node = dynamic_cast<StoreCn *>(&node)) {
+				this->rename(*store_node->address);
+				this->rename(*store_node->value);
+			} else if (CallCn *call_node = dynamic_cast<CallCn *>(&node)) {
+				this->rename(*call_node->callee);
+				for (ArenaUptr<ComputationNode> &argument : call_node->arguments) {
+					this->rename(*argument);
+				}
+			} else if (BranchCn *branch_node = dynamic_cast<BranchCn *>(&node)) {
+				branch_node->jmp_dest = this->block_copies.at(branch_node->jmp_dest);
+				if (branch_node->condition) {
+					this->rename(**branch_node->condition);
+				}
+			} else if (ReturnCn *return_node = dynamic_cast<ReturnCn *>(&node)) {
+				if (return_node->value) {
+					this->rename(**return_node->value);
+				}
+			} else if (LabelCn *label_node = dynamic_cast<LabelCn *>(&node)) {
+				label_node->jmp_dest = this->block_copies.at(label_node->jmp_dest);
+			}
+		}
+	};
+
+	int inline_calls(L3Function &l3_function, const InlineCandidates &candidates) {
+		Vec<Uptr<BasicBlock>> &blocks = l3_function.get_blocks();
+		Arena &arena = l3_function.get_node_arena();
+		int num_inlined = 0;
+		for (size_t i = 0; i < blocks.size();) {
+			Vec<ComputationTreeBox> &tree_boxes = blocks[i]->get_tree_boxes();
+
+			// find the first call to a candidate
+			size_t call_index = 0;
+			const L3Function *callee = nullptr;
+			const Vec<const BasicBlock *> *callee_blocks = nullptr;
+			for (; call_index < tree_boxes.size(); ++call_index) {
+				const CallCn *call_node = dynamic_cast<const CallCn *>(tree_boxes[call_index].get_tree().get());
+				if (!call_node) {
+					continue;
+				}
+				const FunctionCn *callee_node = dynamic_cast<const FunctionCn *>(call_node->callee.get());
+				if (!callee_node) {
+					continue;
+				}
+				Opt<const Vec<const BasicBlock *> *> maybe_callee_blocks = candidates.get_blocks(callee_node->function);
+				if (maybe_callee_blocks
+					&& callee_node->function->verify_argument_num(call_node->arguments.size()))
+				{
+					callee = static_cast<const L3Function *>(callee_node->function);
+					callee_blocks = *maybe_callee_blocks;
+					break;
+				}
+			}
+			if (!callee) {
+				i += 1;
+				continue;
+			}
+			CalleeCopier copier(l3_function, num_inlined);
+			num_inlined += 1;
+
+			// the returns jump to the code after the call, which needs its own
+			// block unless it already starts the next one
+			Uptr<BasicBlock> new_continuation;
+			BasicBlock *continuation;
+			if (call_index + 1 < tree_boxes.size() || i + 1 == blocks.size()) {
+				BasicBlock::Builder builder;
+				builder.add_next_instruction(mkuptr<InstructionLabel>(Symbol::intern(copier.get_label_name("ret"))));
+				new_continuation = builder.get_result(nullptr);
+				Vec<ComputationTreeBox> &continuation_tree_boxes = new_continuation->get_tree_boxes();
+				continuation_tree_boxes.insert(
+					continuation_tree_boxes.end(),
+					std::make_move_iterator(tree_boxes.begin() + call_index + 1),
+					std::make_move_iterator(tree_boxes.end())
+				);
+				continuation = new_continuation.get();
+			} else {
+				continuation = blocks[i + 1].get();
+				if (continuation->get_name().size() == 0) {
+					continuation->mangle_name(copier.get_label_name("ret"));
+				}
+			}
+
+			// the call becomes moves of the arguments into the parameters,
+			// after which the block falls through into the copy of the
+			// callee's entry block
+			ArenaUptr<ComputationNode> call_tree = mv(tree_boxes[call_index].get_tree());
+			tree_boxes.erase(tree_boxes.begin() + call_index, tree_boxes.end());
+			CallCn &call_node = static_cast<CallCn &>(*call_tree);
+			const Vec<Variable *> &parameter_vars = callee->get_parameter_vars();
+			for (size_t j = 0; j < parameter_vars.size(); ++j) {
+				tree_boxes.emplace_back(arena.make<MoveCn>(
+					copier.get_var_copy(parameter_vars[j]),
+					mv(call_node.arguments[j])
+				));
+			}
+			Vec<Uptr<BasicBlock>> copies = copier.copy_blocks(*callee_blocks, call_node.destination, continuation);
+			size_t num_copies = copies.size();
+			if (new_continuation) {
+				copies.push_back(mv(new_continuation));
+			}
+			blocks.insert(
+				blocks.begin() + i + 1,
+				std::make_move_iterator(copies.begin()),
+				std::make_move_iterator(copies.end())
+			);
+
+			// The copies aren't searched for more calls to inline, so inlining
+			// a chain of small functions can't blow up the size of the caller.
+			// The code after the call is searched next.
+			i += 1 + num_copies;
+		}
+
+		if (num_inlined > 0) {
+			BasicBlock::generate_succ_blocks(blocks);
+			BasicBlock::generate_pred_blocks(blocks);
+		}
+		return num_inlined;
+	}
+}
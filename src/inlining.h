@@ -0,0 +1,37 @@
+#pragma once
+#include "program.h"
+
+namespace L3::program::analyze {
+	// the most instructions (not counting labels) a function can have and
+	// still be inlined
+	const int MAX_INLINED_INSTRUCTIONS = 16;
+
+	// The L3 functions whose calls can be replaced by a copy of their body:
+	// the ones with at most MAX_INLINED_INSTRUCTIONS instructions that can't
+	// end up calling themselves.
+	// Must be made before any function is compiled. It keeps its own list of
+	// each candidate's blocks, since the passes on the candidate may add
+	// blocks while another function is being inlined into; the copies are
+	// made from the instructions, which the passes never change.
+	class InlineCandidates {
+		Map<const L3Function *, Vec<const BasicBlock *>> candidate_blocks;
+
+		public:
+
+		explicit InlineCandidates(const Program &program);
+
+		// the blocks of the function if it's a candidate, as they were
+		// before anything was compiled
+		Opt<const Vec<const BasicBlock *> *> get_blocks(const Function *function) const;
+	};
+
+	// Assumes that the computation trees of the function have been generated
+	// and that nothing else has changed them yet.
+	// Replaces each call to a candidate in the function's own code with
+	// moves of the arguments into copies of the candidate's parameters and a
+	// copy of the candidate's blocks, in which every return becomes a move
+	// into the call's destination and a jump to the code after the call.
+	// The copies get new variables and labels, so the data flow must be
+	// generated afterwards. Returns the number of calls inlined.
+	int inline_calls(L3Function &l3_function, const InlineCandidates &candidates);
+}
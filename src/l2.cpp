@@ -0,0 +1,215 @@
+#include "l2.h"
+#include "target_arch.h"
+
+namespace L3::code_gen::l2 {
+	using namespace L3::program;
+
+	Operand Operand::make_variable(const Variable *variable) {
+		Operand result;
+		result.kind = Kind::variable;
+		result.variable = variable;
+		return result;
+	}
+	Operand Operand::make_temp() {
+		Operand result;
+		result.kind = Kind::temp;
+		return result;
+	}
+	Operand Operand::make_register(Register reg) {
+		Operand result;
+		result.kind = Kind::reg;
+		result.reg = reg;
+		return result;
+	}
+	Operand Operand::make_number(int64_t number) {
+		Operand result;
+		result.kind = Kind::number;
+		result.number = number;
+		return result;
+	}
+	Operand Operand::make_label(const BasicBlock *block) {
+		Operand result;
+		result.kind = Kind::label;
+		result.block = block;
+		return result;
+	}
+	Operand Operand::make_call_return_label(int64_t index) {
+		Operand result;
+		result.kind = Kind::call_return_label;
+		result.number = index;
+		return result;
+	}
+	Operand Operand::make_function(const L3::program::Function *function) {
+		Operand result;
+		result.kind = Kind::function;
+		result.function = function;
+		return result;
+	}
+	bool Operand::operator==(const Operand &other) const {
+		if (this->kind != other.kind) {
+			return false;
+		}
+		switch (this->kind) {
+			case Kind::none:
+			case Kind::temp:
+				return true;
+			case Kind::variable: return this->variable == other.variable;
+			case Kind::reg: return this->reg == other.reg;
+			case Kind::number:
+			case Kind::call_return_label:
+				return this->number == other.number;
+			case Kind::label: return this->block == other.block;
+			case Kind::function: return this->function == other.function;
+		}
+		return false;
+	}
+
+	static Instruction make_instruction(Opcode opcode, Operator op, int64_t immediate, Operand a = Operand(), Operand b = Operand(), Operand c = Operand()) {
+		return Instruction { opcode, op, immediate, { a, b, c } };
+	}
+
+	// the operator of instructions that don't use one
+	static const Operator NO_OP = Operator::eq;
+
+	Instruction Instruction::make_assign(Operand dest, Operand source) {
+		return make_instruction(Opcode::assign, NO_OP, 0, dest, source);
+	}
+	Instruction Instruction::make_assign_op(Operand dest, Operator op, Operand source) {
+		return make_instruction(Opcode::assign_op, op, 0, dest, source);
+	}
+	Instruction Instruction::make_assign_compare(Operand dest, Operand lhs, Operator op, Operand rhs) {
+		return make_instruction(Opcode::assign_compare, op, 0, dest, lhs, rhs);
+	}
+	Instruction Instruction::make_load(Operand dest, Operand base, int64_t offset) {
+		return make_instruction(Opcode::load, NO_OP, offset, dest, base);
+	}
+	Instruction Instruction::make_store(Operand base, int64_t offset, Operand source) {
+		return make_instruction(Opcode::store, NO_OP, offset, base, source);
+	}
+	Instruction Instruction::make_load_op(Operand dest, Operator op, Operand base, int64_t offset) {
+		return make_instruction(Opcode::load_op, op, offset, dest, base);
+	}
+	Instruction Instruction::make_store_op(Operand base, int64_t offset, Operator op, Operand source) {
+		return make_instruction(Opcode::store_op, op, offset, base, source);
+	}
+	Instruction Instruction::make_lea(Operand dest, Operand base, Operand index, int64_t scale) {
+		return make_instruction(Opcode::lea, NO_OP, scale, dest, base, index);
+	}
+	Instruction Instruction::make_stack_arg(Operand dest, int64_t offset) {
+		return make_instruction(Opcode::stack_arg, NO_OP, offset, dest);
+	}
+	Instruction Instruction::make_cjump(Operand lhs, Operator op, Operand rhs, Operand label) {
+		return make_instruction(Opcode::cjump, op, 0, lhs, rhs, label);
+	}
+	Instruction Instruction::make_goto(Operand label) {
+		return make_instruction(Opcode::goto_, NO_OP, 0, label);
+	}
+	Instruction Instruction::make_label(Operand label) {
+		return make_instruction(Opcode::label, NO_OP, 0, label);
+	}
+	Instruction Instruction::make_call(Operand callee, int64_t num_arguments) {
+		return make_instruction(Opcode::call, NO_OP, num_arguments, callee);
+	}
+	Instruction Instruction::make_return() {
+		return make_instruction(Opcode::return_, NO_OP, 0);
+	}
+
+	void print_operand(std::ostream &o, const Operand &operand, const Function &function) {
+		static const char *const register_names[] = {
+			"rax", "rdi", "rsi", "rdx", "rcx", "r8", "r9", "rsp"
+		};
+
+		switch (operand.kind) {
+			case Operand::Kind::none:
+				std::cerr << "Error: tried to print a missing L2 operand\n";
+				exit(1);
+			case Operand::Kind::variable:
+				o << "%_" << operand.variable->get_name();
+				break;
+			case Operand::Kind::temp:
+				o << "%_";
+				break;
+			case Operand::Kind::reg:
+				o << register_names[static_cast<int>(operand.reg)];
+				break;
+			case Operand::Kind::number:
+				o << operand.number;
+				break;
+			case Operand::Kind::label:
+				o << ":" << operand.block->get_name();
+				break;
+			case Operand::Kind::call_return_label:
+				o << ":" << target_arch::make_generated_label_name(
+					"callret", function.l3_function.get_name(), std::to_string(operand.number)
+				);
+				break;
+			case Operand::Kind::function:
+				if (dynamic_cast<const L3Function *>(operand.function)) {
+					o << "@";
+				}
+				o << operand.function->get_name();
+				break;
+		}
+	}
+
+	void print_instruction(std::ostream &o, const Instruction &inst, const Function &function) {
+		auto print = [&](int operand_index) {
+			print_operand(o, inst.operands[operand_index], function);
+		};
+		switch (inst.opcode) {
+			case Opcode::assign:
+				print(0); o << " <- "; print(1);
+				break;
+			case Opcode::assign_op:
+				print(0); o << " " << program::to_string(inst.op) << "= "; print(1);
+				break;
+			case Opcode::assign_compare:
+				print(0); o << " <- "; print(1); o << " " << program::to_string(inst.op) << " "; print(2);
+				break;
+			case Opcode::load:
+				print(0); o << " <- mem "; print(1); o << " " << inst.immediate;
+				break;
+			case Opcode::store:
+				o << "mem "; print(0); o << " " << inst.immediate << " <- "; print(1);
+				break;
+			case Opcode::load_op:
+				print(0); o << " " << program::to_string(inst.op) << "= mem "; print(1); o << " " << inst.immediate;
+				break;
+			case Opcode::store_op:
+				o << "mem "; print(0); o << " " << inst.immediate << " " << program::to_string(inst.op) << "= "; print(1);
+				break;
+			case Opcode::lea:
+				print(0); o << " @ "; print(1); o << " "; print(2); o << " " << inst.immediate;
+				break;
+			case Opcode::stack_arg:
+				print(0); o << " <- stack-arg " << inst.immediate;
+				break;
+			case Opcode::cjump:
+				o << "cjump "; print(0); o << " " << program::to_string(inst.op) << " "; print(1); o << " "; print(2);
+				break;
+			case Opcode::goto_:
+				o << "goto "; print(0);
+				break;
+			case Opcode::label:
+				print(0);
+				break;
+			case Opcode::call:
+				o << "call "; print(0); o << " " << inst.immediate;
+				break;
+			case Opcode::return_:
+				o << "return";
+				break;
+		}
+	}
+
+	void print_function(std::ostream &o, const Function &function) {
+		o << "\t(@" << function.l3_function.get_name()
+			<< " " << function.l3_function.get_parameter_vars().size() << "\n";
+		for (const Instruction &inst : function.instructions) {
+			o << "\t\t";
+			print_instruction(o, inst, function);
+			o << "\n";
+		}
+		o << "\t)\n";
+	}
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include "std_alias.h"
+#include "program.h"
+#include <cstdint>
+#include <iostream>
+
+// An in-memory form of the L2 code that the tiles generate. Operands are
+// small handles into the L3 program (or registers and numbers) instead of
+// strings, and the text of the L2 program is only produced when a whole
+// function is printed at the end, which also leaves room for passes over the
+// L2 instructions before then.
+namespace L3::code_gen::l2 {
+	using namespace std_alias;
+	using L3::program::Operator;
+
+	enum struct Register : uint8_t {
+		rax,
+		rdi,
+		rsi,
+		rdx,
+		rcx,
+		r8,
+		r9,
+		rsp
+	};
+
+	struct Operand {
+		enum struct Kind : uint8_t {
+			none,
+			variable, // an L3 variable
+			temp, // the scratch variable `%_` used inside tiles
+			reg,
+			number,
+			label, // the label of a basic block
+			call_return_label, // the nth return label generated in the function
+			function
+		};
+
+		Kind kind;
+		union {
+			const L3::program::Variable *variable;
+			Register reg;
+			int64_t number; // also the index of a call_return_label
+			const L3::program::BasicBlock *block;
+			const L3::program::Function *function;
+		};
+
+		Operand() : kind { Kind::none }, number { 0 } {}
+		static Operand make_variable(const L3::program::Variable *variable);
+		static Operand make_temp();
+		static Operand make_register(Register reg);
+		static Operand make_number(int64_t number);
+		static Operand make_label(const L3::program::BasicBlock *block);
+		static Operand make_call_return_label(int64_t index);
+		static Operand make_function(const L3::program::Function *function);
+
+		bool operator==(const Operand &other) const;
+		bool operator!=(const Operand &other) const { return !(*this == other); }
+	};
+
+	enum struct Opcode : uint8_t {
+		assign, // dest <- source
+		assign_op, // dest op= source
+		assign_compare, // dest <- lhs op rhs
+		load, // dest <- mem base immediate
+		store, // mem base immediate <- source
+		load_op, // dest op= mem base immediate
+		store_op, // mem base immediate op= source
+		lea, // dest @ base index immediate
+		stack_arg, // dest <- stack-arg immediate
+		cjump, // cjump lhs op rhs label
+		goto_, // goto label
+		label, // label
+		call, // call callee immediate
+		return_ // return
+	};
+
+	// A single L2 instruction. Which operands are used depends on the
+	// opcode; see the factory functions for the order they go in.
+	struct Instruction {
+		Opcode opcode;
+		Operator op; // for assign_op, assign_compare, load_op, store_op, and cjump
+		int64_t immediate; // a memory offset, lea scale, stack-arg offset, or number of call arguments
+		Operand operands[3];
+
+		static Instruction make_assign(Operand dest, Operand source);
+		static Instruction make_assign_op(Operand dest, Operator op, Operand source);
+		static Instruction make_assign_compare(Operand dest, Operand lhs, Operator op, Operand rhs);
+		static Instruction make_load(Operand dest, Operand base, int64_t offset);
+		static Instruction make_store(Operand base, int64_t offset, Operand source);
+		static Instruction make_load_op(Operand dest, Operator op, Operand base, int64_t offset);
+		static Instruction make_store_op(Operand base, int64_t offset, Operator op, Operand source);
+		static Instruction make_lea(Operand dest, Operand base, Operand index, int64_t scale);
+		static Instruction make_stack_arg(Operand dest, int64_t offset);
+		static Instruction make_cjump(Operand lhs, Operator op, Operand rhs, Operand label);
+		static Instruction make_goto(Operand label);
+		static Instruction make_label(Operand label);
+		static Instruction make_call(Operand callee, int64_t num_arguments);
+		static Instruction make_return();
+	};
+
+	// The L2 code of a single L3 function.
+	struct Function {
+		const L3::program::L3Function &l3_function;
+		Vec<Instruction> instructions;
+
+		Function(const L3::program::L3Function &l3_function) : l3_function { l3_function } {}
+	};
+
+	void print_operand(std::ostream &o, const Operand &operand, const Function &function);
+	void print_instruction(std::ostream &o, const Instruction &inst, const Function &function);
+
+	// prints the function in L2 syntax, including its header
+	void print_function(std::ostream &o, const Function &function);
+}
@@ -0,0 +1,220 @@
+#include "loop_invariant_code_motion.h"
+#include "analyze_trees.h"
+#include "loops.h"
+#include "target_arch.h"
+#include "std_alias.h"
+#include <algorithm>
+
+namespace L3::program::analyze {
+	using namespace std_alias;
+
+	// whether evaluating the tree can't do anything besides compute its
+	// value; with `allow_loads`, reading memory also counts
+	bool is_pure(const ComputationNode &tree, bool allow_loads) {
+		if (is_dynamic_type<NumberCn, VariableCn, LabelCn, FunctionCn>(tree)) {
+			return true;
+		}
+		if (const MoveCn *move_node = dynamic_cast<const MoveCn *>(&tree)) {
+			return is_pure(*move_node->source, allow_loads);
+		}
+		if (const BinaryCn *bin_node = dynamic_cast<const BinaryCn *>(&tree)) {
+			return is_pure(*bin_node->lhs, allow_loads) && is_pure(*bin_node->rhs, allow_loads);
+		}
+		if (const LoadCn *load_node = dynamic_cast<const LoadCn *>(&tree)) {
+			return allow_loads && is_pure(*load_node->address, allow_loads);
+		}
+		return false;
+	}
+
+	// Moves the invariant trees of the loop into its preheader, creating the
+	// preheader if the loop doesn't already have one. Returns whether any
+	// tree moved.
+	bool hoist_from_loop(L3Function &l3_function, const Loop &loop, const Dominators &dominators) {
+		Vec<Uptr<BasicBlock>> &blocks = l3_function.get_blocks();
+		BasicBlock *header = loop.header;
+		size_t header_index = 0;
+		while (blocks[header_index].get() != header) {
+			header_index += 1;
+		}
+		// a new preheader goes right before the header, which can't work if
+		// the loop falls through into the header
+		if (header_index > 0
+			&& loop.blocks.count(blocks[header_index - 1].get()) > 0
+			&& blocks[header_index - 1]->falls_through())
+		{
+			return false;
+		}
+
+		Map<Variable *, int> num_writes;
+		bool loop_writes_memory = false;
+		Vec<BasicBlock *> exiting_blocks;
+		for (BasicBlock *block : loop.blocks) {
+			for (const ComputationTreeBox &tree_box : block->get_tree_boxes()) {
+				if (Opt<Variable *> var_written = tree_box.get_var_written()) {
+					num_writes[*var_written] += 1;
+				}
+				// the trees aren't merged, so a call or store is at the root
+				if (may_write_memory(*tree_box.get_tree())) {
+					loop_writes_memory = true;
+				}
+			}
+			for (BasicBlock *succ : block->get_succ_blocks()) {
+				if (loop.blocks.count(succ) == 0) {
+					exiting_blocks.push_back(block);
+					break;
+				}
+			}
+		}
+
+		// A load that moves out of the loop happens even if the loop would
+		// have left before reaching it, which is only safe if its block
+		// runs on the way out of every exit anyway.
+		auto runs_before_every_exit = [&](BasicBlock *block) {
+			if (exiting_blocks.empty()) {
+				return false;
+			}
+			for (BasicBlock *exiting_block : exiting_blocks) {
+				if (!dominators.dominates(block, exiting_block)) {
+					return false;
+				}
+			}
+			return true;
+		};
+
+		// A tree's value is the same on every iteration if nothing in the
+		// loop writes the variables it reads. It can then run once before
+		// the loop if it's the only write of its variable in the loop, and
+		// the variable isn't live into the header (so no read in the loop
+		// can see a value from before the tree or from outside the loop).
+		const VarSet &header_in_set = header->get_in_set();
+		auto is_invariant = [&](const ComputationTreeBox &tree_box, BasicBlock *block) {
+			Opt<Variable *> var_written = tree_box.get_var_written();
+			if (!var_written
+				|| num_writes[*var_written] != 1
+				|| header_in_set.contains(*var_written))
+			{
+				return false;
+			}
+			bool allow_loads = !loop_writes_memory && runs_before_every_exit(block);
+			if (!is_pure(*tree_box.get_tree(), allow_loads)) {
+				return false;
+			}
+			for (Variable *var : tree_box.get_variables_read()) {
+				if (auto it = num_writes.find(var); it != num_writes.end() && it->second > 0) {
+					return false;
+				}
+			}
+			return true;
+		};
+
+		// Moving a tree out can make the trees that read its variable
+		// invariant, so keep going until nothing moves. The trees are moved
+		// out in an order that respects the dependencies between them.
+		Vec<ComputationTreeBox> hoisted_boxes;
+		bool changed = true;
+		while (changed) {
+			changed = false;
+			for (Uptr<BasicBlock> &block : blocks) {
+				if (loop.blocks.count(block.get()) == 0) {
+					continue;
+				}
+				Vec<ComputationTreeBox> &tree_boxes = block->get_tree_boxes();
+				for (size_t i = 0; i < tree_boxes.size();) {
+					if (is_invariant(tree_boxes[i], block.get())) {
+						num_writes[*tree_boxes[i].get_var_written()] -= 1;
+						hoisted_boxes.push_back(mv(tree_boxes[i]));
+						tree_boxes.erase(tree_boxes.begin() + i);
+						changed = true;
+					} else {
+						++i;
+					}
+				}
+			}
+		}
+		if (hoisted_boxes.empty()) {
+			return false;
+		}
+
+		Vec<BasicBlock *> outside_preds;
+		for (BasicBlock *pred : header->get_pred_blocks()) {
+			if (loop.blocks.count(pred) == 0) {
+				outside_preds.push_back(pred);
+			}
+		}
+
+		// An existing block can serve as the preheader if the loop is the
+		// only place it goes and nothing else enters the loop. The trees go
+		// before its jump to the header, if it has one.
+		if (outside_preds.size() == 1 && dominators.is_reachable(outside_preds[0])) {
+			BasicBlock *pred = outside_preds[0];
+			const Vec<BasicBlock *> &pred_succs = pred->get_succ_blocks();
+			Vec<ComputationTreeBox> &pred_tree_boxes = pred->get_tree_boxes();
+			bool only_goes_to_header = std::all_of(pred_succs.begin(), pred_succs.end(), [&](BasicBlock *succ) {
+				return succ == header;
+			});
+			auto insert_it = pred_tree_boxes.end();
+			if (!pred_tree_boxes.empty()) {
+				if (const BranchCn *branch_node = dynamic_cast<const BranchCn *>(pred_tree_boxes.back().get_tree().get())) {
+					// the condition of a branch might read a hoisted variable
+					only_goes_to_header = only_goes_to_header && !branch_node->condition;
+					insert_it -= 1;
+				}
+			}
+			if (only_goes_to_header) {
+				pred_tree_boxes.insert(
+					insert_it,
+					std::make_move_iterator(hoisted_boxes.begin()),
+					std::make_move_iterator(hoisted_boxes.end())
+				);
+				return true;
+			}
+		}
+
+		// Otherwise make a new block laid out right before the header, so
+		// that whatever fell through into the header falls through into the
+		// preheader instead.
+		BasicBlock::Builder preheader_builder;
+		if (header->get_name().size() > 0) {
+			preheader_builder.add_next_instruction(mkuptr<InstructionLabel>(Symbol::intern(
+				code_gen::target_arch::make_generated_label_name("preheader", l3_function.get_name(), header->get_name())
+			)));
+		}
+		Uptr<BasicBlock> preheader = preheader_builder.get_result(header);
+		preheader->generate_computation_trees(l3_function.get_node_arena());
+		Vec<ComputationTreeBox> &preheader_tree_boxes = preheader->get_tree_boxes();
+		preheader_tree_boxes.insert(
+			preheader_tree_boxes.end(),
+			std::make_move_iterator(hoisted_boxes.begin()),
+			std::make_move_iterator(hoisted_boxes.end())
+		);
+		for (BasicBlock *pred : outside_preds) {
+			pred->replace_succ_block(header, preheader.get());
+		}
+		blocks.insert(blocks.begin() + header_index, mv(preheader));
+		BasicBlock::generate_pred_blocks(blocks);
+		return true;
+	}
+
+	int hoist_loop_invariants(L3Function &l3_function) {
+		// Moving trees changes the liveness that the next loop relies on,
+		// and a new preheader changes the loops around it, so everything is
+		// recomputed after each loop. The header is remembered since it
+		// stays the same through all that.
+		int num_iterations = 0;
+		Set<BasicBlock *> visited_headers;
+		while (true) {
+			Dominators dominators(l3_function);
+			Vec<Loop> loops = find_loops(l3_function, dominators);
+			auto loop_it = std::find_if(loops.begin(), loops.end(), [&](const Loop &loop) {
+				return visited_headers.count(loop.header) == 0;
+			});
+			if (loop_it == loops.end()) {
+				return num_iterations;
+			}
+			visited_headers.insert(loop_it->header);
+			if (hoist_from_loop(l3_function, *loop_it, dominators)) {
+				num_iterations += generate_data_flow(l3_function);
+			}
+		}
+	}
+}
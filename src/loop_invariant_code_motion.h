@@ -0,0 +1,16 @@
+#pragma once
+#include "program.h"
+
+namespace L3::program::analyze {
+	// Assumes that data flow has already been generated for the function and
+	// that the trees haven't been merged yet.
+	// Moves the trees of each loop that compute the same value on every
+	// iteration into a preheader: a block that runs once right before the
+	// loop is entered. Only trees without side effects that are the sole
+	// write of their variable in the loop are moved, and loads only if
+	// nothing in the loop can write memory. Inner loops are done first, so
+	// an invariant can move out of several loops.
+	// The data flow is regenerated whenever the trees move; returns the
+	// number of block updates that took.
+	int hoist_loop_invariants(L3Function &l3_function);
+}
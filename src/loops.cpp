@@ -0,0 +1,124 @@
+#include "loops.h"
+#include "analyze_trees.h"
+#include "std_alias.h"
+#include <algorithm>
+
+namespace L3::program::analyze {
+	using namespace std_alias;
+
+	Dominators::Dominators(L3Function &l3_function) {
+		Vec<Uptr<BasicBlock>> &blocks = l3_function.get_blocks();
+		if (blocks.empty()) {
+			return;
+		}
+		Vec<BasicBlock *> postorder = get_postorder(l3_function);
+		for (int i = 0; i < postorder.size(); ++i) {
+			this->postorder_indices.insert({ postorder[i], i });
+		}
+
+		// "A Simple, Fast Dominance Algorithm" by Cooper, Harvey, and
+		// Kennedy: each block's idom is the nearest common dominator of its
+		// processed predecessors, iterated in reverse postorder until it
+		// settles. A block is later in the postorder than everything it
+		// dominates, so walking up from the block with the smaller index
+		// finds the common dominator.
+		BasicBlock *entry_block = blocks.front().get();
+		this->idoms.insert({ entry_block, entry_block });
+		auto intersect = [&](BasicBlock *a, BasicBlock *b) {
+			while (a != b) {
+				while (this->postorder_indices.at(a) < this->postorder_indices.at(b)) {
+					a = this->idoms.at(a);
+				}
+				while (this->postorder_indices.at(b) < this->postorder_indices.at(a)) {
+					b = this->idoms.at(b);
+				}
+			}
+			return a;
+		};
+		bool changed = true;
+		while (changed) {
+			changed = false;
+			for (auto it = postorder.rbegin(); it != postorder.rend(); ++it) {
+				BasicBlock *block = *it;
+				if (block == entry_block) {
+					continue;
+				}
+				BasicBlock *new_idom = nullptr;
+				for (BasicBlock *pred : block->get_pred_blocks()) {
+					if (this->idoms.count(pred) == 0) {
+						continue; // not processed yet, or unreachable
+					}
+					new_idom = new_idom ? intersect(pred, new_idom) : pred;
+				}
+				if (!new_idom) {
+					continue;
+				}
+				auto [idom_it, inserted] = this->idoms.insert({ block, new_idom });
+				if (inserted || idom_it->second != new_idom) {
+					idom_it->second = new_idom;
+					changed = true;
+				}
+			}
+		}
+	}
+
+	bool Dominators::dominates(BasicBlock *dominator, BasicBlock *block) const {
+		if (!this->is_reachable(dominator) || !this->is_reachable(block)) {
+			return false;
+		}
+		while (block != dominator) {
+			BasicBlock *idom = this->idoms.at(block);
+			if (idom == block) {
+				return false; // reached the entry block
+			}
+			block = idom;
+		}
+		return true;
+	}
+
+	Vec<Loop> find_loops(L3Function &l3_function, const Dominators &dominators) {
+		// the loops in the order their headers are laid out
+		Vec<Loop> loops;
+		Map<BasicBlock *, size_t> loop_indices;
+		for (Uptr<BasicBlock> &block : l3_function.get_blocks()) {
+			for (BasicBlock *succ : block->get_succ_blocks()) {
+				if (!dominators.dominates(succ, block.get())) {
+					continue;
+				}
+				// a back edge
+				auto [index_it, inserted] = loop_indices.insert({ succ, loops.size() });
+				if (inserted) {
+					loops.push_back(Loop { succ, { succ }, {} });
+				}
+				loops[index_it->second].latches.push_back(block.get());
+			}
+		}
+
+		// the body is everything that reaches a latch without going
+		// through the header
+		for (Loop &loop : loops) {
+			Vec<BasicBlock *> worklist;
+			for (BasicBlock *latch : loop.latches) {
+				if (loop.blocks.insert(latch).second) {
+					worklist.push_back(latch);
+				}
+			}
+			while (!worklist.empty()) {
+				BasicBlock *block = worklist.back();
+				worklist.pop_back();
+				for (BasicBlock *pred : block->get_pred_blocks()) {
+					if (dominators.is_reachable(pred) && loop.blocks.insert(pred).second) {
+						worklist.push_back(pred);
+					}
+				}
+			}
+		}
+
+		// a nested loop has a strict subset of the blocks of the loops
+		// around it
+		std::stable_sort(loops.begin(), loops.end(), [](const Loop &a, const Loop &b) {
+			return a.blocks.size() < b.blocks.size();
+		});
+		return loops;
+	}
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include "program.h"
+
+namespace L3::program::analyze {
+	// The dominator tree of a function's control flow graph, built from the
+	// successors of its blocks. A block dominates another if every path from
+	// the entry block to the other block goes through it. Blocks that can't
+	// be reached from the entry dominate nothing and are dominated by
+	// nothing.
+	class Dominators {
+		Map<BasicBlock *, BasicBlock *> idoms; // the entry block is its own idom
+		Map<BasicBlock *, int> postorder_indices;
+
+		public:
+
+		explicit Dominators(L3Function &l3_function);
+
+		bool is_reachable(BasicBlock *block) const { return this->idoms.count(block) > 0; }
+		// whether `dominator` dominates `block`; every block dominates itself
+		bool dominates(BasicBlock *dominator, BasicBlock *block) const;
+	};
+
+	// A natural loop: the header and every block that can reach one of the
+	// back edges into the header without going through the header. All the
+	// back edges into the same header make up a single loop.
+	struct Loop {
+		BasicBlock *header;
+		Set<BasicBlock *> blocks; // includes the header
+		Vec<BasicBlock *> latches; // the blocks with a back edge to the header
+	};
+
+	// Finds the natural loops of the function, ordered so that a loop
+	// nested in another comes before it.
+	Vec<Loop> find_loops(L3Function &l3_function, const Dominators &dominators);
+}
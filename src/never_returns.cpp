@@ -0,0 +1,117 @@
+#include "never_returns.h"
+#include "analyze_trees.h"
+#include "std_alias.h"
+
+namespace L3::program::analyze {
+	using namespace std_alias;
+
+	// what a block does as far as returning goes, up to its first return
+	struct BlockSummary {
+		Vec<const Function *> callees; // the functions called by name, in order
+		bool returns;
+	};
+
+	// Whether a return can be reached from the entry block of the function
+	// with the given block summaries, where a call to a function that never
+	// returns ends the path.
+	bool can_return(const L3Function &l3_function, const Map<const BasicBlock *, BlockSummary> &summaries) {
+		const Vec<Uptr<BasicBlock>> &blocks = l3_function.get_blocks();
+		if (blocks.empty()) {
+			return false;
+		}
+		Vec<const BasicBlock *> worklist { blocks.front().get() };
+		Set<const BasicBlock *> visited { blocks.front().get() };
+		while (!worklist.empty()) {
+			const BasicBlock *block = worklist.back();
+			worklist.pop_back();
+			const BlockSummary &summary = summaries.at(block);
+			bool is_stopped = false;
+			for (const Function *callee : summary.callees) {
+				if (callee->get_never_returns()) {
+					is_stopped = true;
+					break;
+				}
+			}
+			if (is_stopped) {
+				continue;
+			}
+			if (summary.returns) {
+				return true;
+			}
+			for (const BasicBlock *succ : block->get_succ_blocks()) {
+				if (visited.insert(succ).second) {
+					worklist.push_back(succ);
+				}
+			}
+		}
+		return false;
+	}
+
+	void find_never_returning_functions(Program &program) {
+		// The trees of the functions haven't been generated yet, so make
+		// throwaway ones to see what each block calls.
+		Arena scratch_arena;
+		Map<const BasicBlock *, BlockSummary> summaries;
+		for (const Uptr<L3Function> &l3_function : program.get_l3_functions()) {
+			for (const Uptr<BasicBlock> &block : l3_function->get_blocks()) {
+				BlockSummary &summary = summaries[block.get()];
+				summary.returns = false;
+				for (const Uptr<Instruction> &inst : block->get_raw_instructions()) {
+					ArenaUptr<ComputationNode> tree = inst->to_computation_tree(scratch_arena);
+					if (is_dynamic_type<ReturnCn>(*tree)) {
+						summary.returns = true;
+						break;
+					}
+					if (const CallCn *call_node = dynamic_cast<const CallCn *>(tree.get())) {
+						if (const FunctionCn *callee_node = dynamic_cast<const FunctionCn *>(call_node->callee.get())) {
+							summary.callees.push_back(callee_node->function);
+						}
+					}
+				}
+			}
+		}
+
+		// Start by assuming that no L3 function returns, and take that back
+		// for each one that can reach a return until nothing changes. A
+		// function that can only return through a call to itself is left
+		// marked, since that call never comes back either.
+		Vec<Uptr<L3Function>> &l3_functions = program.get_l3_functions();
+		for (Uptr<L3Function> &l3_function : l3_functions) {
+			l3_function->set_never_returns(true);
+		}
+		bool changed = true;
+		while (changed) {
+			changed = false;
+			for (Uptr<L3Function> &l3_function : l3_functions) {
+				if (l3_function->get_never_returns() && can_return(*l3_function, summaries)) {
+					l3_function->set_never_returns(false);
+					changed = true;
+				}
+			}
+		}
+	}
+
+	int end_blocks_at_never_returning_calls(L3Function &l3_function) {
+		Vec<Uptr<BasicBlock>> &blocks = l3_function.get_blocks();
+		int num_ended = 0;
+		for (Uptr<BasicBlock> &block : blocks) {
+			Vec<ComputationTreeBox> &tree_boxes = block->get_tree_boxes();
+			for (size_t i = 0; i < tree_boxes.size(); ++i) {
+				const CallCn *call_node = dynamic_cast<const CallCn *>(tree_boxes[i].get_tree().get());
+				if (call_node && get_call_effects(*call_node).never_returns) {
+					// a block that already ended at the call only loses
+					// its fallthrough edge
+					bool is_last = i + 1 == tree_boxes.size();
+					tree_boxes.erase(tree_boxes.begin() + i + 1, tree_boxes.end());
+					if (!is_last || block->get_succ_blocks().size() > 0) {
+						num_ended += 1;
+					}
+					break;
+				}
+			}
+		}
+		BasicBlock::generate_succ_blocks(blocks);
+		BasicBlock::generate_pred_blocks(blocks);
+		return num_ended;
+	}
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include "program.h"
+
+namespace L3::program::analyze {
+	// Marks the L3 functions that never return: the ones where every path
+	// from the entry block reaches a call to a function that never returns
+	// (like tensor-error) before it reaches a return. A function that only
+	// ever calls itself or loops forever counts too.
+	// Must run before any function is compiled, since it reads the blocks'
+	// instructions and successors as the parser made them.
+	void find_never_returning_functions(Program &program);
+
+	// Assumes that the computation trees of the function have been
+	// generated and haven't been merged yet.
+	// Ends each block at its first call to a function that never returns,
+	// removing the trees after the call, so the block has no successors
+	// and nothing after the call stays live. The succ and pred blocks are
+	// regenerated, and the data flow must be generated afterwards. Returns
+	// the number of blocks ended early.
+	int end_blocks_at_never_returning_calls(L3Function &l3_function);
+}
@@ -14,6 +14,7 @@
 #include <stdint.h>
 #include <assert.h>
 #include <fstream>
+#include <type_traits>
 
 #include <tao/pegtl.hpp>
 #include <tao/pegtl/contrib/analyze.hpp>
@@ -460,22 +461,22 @@ namespace L3::parser {
 
 		Uptr<ItemRef<Variable>> make_variable_ref(const ParseNode &n) {
 			assert(*n.rule == typeid(rules::VariableRule));
-			return mkuptr<ItemRef<Variable>>(std::string(convert_name_rule(n[0])));
+			return mkuptr<ItemRef<Variable>>(Symbol::intern(convert_name_rule(n[0])));
 		}
 
 		Uptr<ItemRef<L3Function>> make_l3_function_ref(const ParseNode &n) {
 			assert(*n.rule == typeid(rules::L3FunctionNameRule));
-			return mkuptr<ItemRef<L3Function>>(std::string(convert_name_rule(n[0])));
+			return mkuptr<ItemRef<L3Function>>(Symbol::intern(convert_name_rule(n[0])));
 		}
 
 		Uptr<ItemRef<ExternalFunction>> make_external_function_ref(const ParseNode &n) {
 			assert(*n.rule == typeid(rules::StdFunctionNameRule));
-			return mkuptr<ItemRef<ExternalFunction>>(std::string(n.string_view()));
+			return mkuptr<ItemRef<ExternalFunction>>(Symbol::intern(n.string_view()));
 		}
 
 		Uptr<ItemRef<BasicBlock>> make_label_ref(const ParseNode &n) {
 			assert(*n.rule == typeid(rules::LabelRule));
-			return mkuptr<ItemRef<BasicBlock>>(std::string(convert_name_rule(n[0])));
+			return mkuptr<ItemRef<BasicBlock>>(Symbol::intern(convert_name_rule(n[0])));
 		}
 
 		Uptr<NumberLiteral> make_number_literal(const ParseNode &n) {
@@ -590,7 +591,7 @@ namespace L3::parser {
 		Uptr<Instruction> convert_instruction_label_rule(const ParseNode &n) {
 			assert(*n.rule == typeid(rules::InstructionLabelRule));
 			return mkuptr<InstructionLabel>(
-				std::string(convert_name_rule(n[0][0]))
+				Symbol::intern(convert_name_rule(n[0][0]))
 			);
 		}
 
@@ -665,7 +666,7 @@ namespace L3::parser {
 			const ParseNode &def_args = n[1];
 			assert(*def_args.rule == typeid(rules::DefArgsRule));
 			for (const Uptr<ParseNode> &def_arg : def_args.children) {
-				builder.add_parameter(std::string(convert_name_rule((*def_arg)[0])));
+				builder.add_parameter(Symbol::intern(convert_name_rule((*def_arg)[0])));
 			}
 
 			// add instructions
@@ -689,6 +690,270 @@ namespace L3::parser {
 		}
 	}
 
+	// Builds the program directly from PEGTL actions while the input is being
+	// parsed, so that no parse tree has to be materialized. The rules for
+	// names and numbers push tokens onto a small stack, and each instruction
+	// rule turns the tokens it matched into an Instruction once it succeeds.
+	// The node_processor path is only used when the parse tree is requested.
+	namespace actions {
+		using namespace L3::program;
+
+		struct Token {
+			const std::type_info *rule; // which rule this token matched on
+			std::string_view text;
+		};
+
+		struct ParseState {
+			Program::Builder program_builder;
+			Uptr<L3Function::Builder> function_builder; // the function currently being parsed
+			Vec<Token> tokens; // the tokens of the current instruction or function header
+		};
+
+		// the name of a variable, label, or L3 function, without the sigil
+		Symbol get_name(const Token &t) {
+			assert(*t.rule == typeid(rules::VariableRule)
+				|| *t.rule == typeid(rules::LabelRule)
+				|| *t.rule == typeid(rules::L3FunctionNameRule));
+			return Symbol::intern(t.text.substr(1));
+		}
+
+		Uptr<ItemRef<Variable>> make_variable_ref(const Token &t) {
+			assert(*t.rule == typeid(rules::VariableRule));
+			return mkuptr<ItemRef<Variable>>(get_name(t));
+		}
+
+		Uptr<ItemRef<BasicBlock>> make_label_ref(const Token &t) {
+			assert(*t.rule == typeid(rules::LabelRule));
+			return mkuptr<ItemRef<BasicBlock>>(get_name(t));
+		}
+
+		Uptr<Expr> make_expr(const Token &t) {
+			const std::type_info &rule = *t.rule;
+			if (rule == typeid(rules::VariableRule)) {
+				return make_variable_ref(t);
+			} else if (rule == typeid(rules::LabelRule)) {
+				return make_label_ref(t);
+			} else if (rule == typeid(rules::L3FunctionNameRule)) {
+				return mkuptr<ItemRef<L3Function>>(get_name(t));
+			} else if (rule == typeid(rules::StdFunctionNameRule)) {
+				return mkuptr<ItemRef<ExternalFunction>>(Symbol::intern(t.text));
+			} else if (rule == typeid(rules::NumberRule)) {
+				return mkuptr<NumberLiteral>(t.text);
+			} else {
+				std::cerr << "Cannot make Expr from the token \"" << t.text << "\"\n";
+				exit(1);
+			}
+		}
+
+		Operator make_operator(const Token &t) {
+			assert(*t.rule == typeid(rules::ComparisonOperatorRule)
+				|| *t.rule == typeid(rules::ArithmeticOperatorRule));
+			return str_to_op(t.text);
+		}
+
+		// makes a function call out of the callee at tokens[first] and the
+		// arguments after it
+		Uptr<FunctionCall> make_function_call(const Vec<Token> &tokens, size_t first) {
+			Uptr<Expr> callee = make_expr(tokens.at(first));
+			Vec<Uptr<Expr>> arguments;
+			for (size_t i = first + 1; i < tokens.size(); ++i) {
+				arguments.emplace_back(make_expr(tokens[i]));
+			}
+			return mkuptr<FunctionCall>(mv(callee), mv(arguments));
+		}
+
+		void add_instruction(ParseState &state, Uptr<Instruction> &&inst) {
+			state.function_builder->add_next_instruction(mv(inst));
+			state.tokens.clear();
+		}
+
+		template<typename Rule>
+		struct Action : pegtl::nothing<Rule> {};
+
+		template<typename Rule>
+		struct PushToken {
+			template<typename ActionInput>
+			static void apply(const ActionInput &in, ParseState &state) {
+				state.tokens.push_back(Token { &typeid(Rule), in.string_view() });
+			}
+		};
+
+		template<> struct Action<rules::VariableRule> : PushToken<rules::VariableRule> {};
+		template<> struct Action<rules::LabelRule> : PushToken<rules::LabelRule> {};
+		template<> struct Action<rules::L3FunctionNameRule> : PushToken<rules::L3FunctionNameRule> {};
+		template<> struct Action<rules::NumberRule> : PushToken<rules::NumberRule> {};
+		template<> struct Action<rules::ComparisonOperatorRule> : PushToken<rules::ComparisonOperatorRule> {};
+		template<> struct Action<rules::ArithmeticOperatorRule> : PushToken<rules::ArithmeticOperatorRule> {};
+		template<> struct Action<rules::StdFunctionNameRule> : PushToken<rules::StdFunctionNameRule> {};
+
+		template<> struct Action<rules::InstructionPureAssignmentRule> {
+			template<typename ActionInput>
+			static void apply(const ActionInput &, ParseState &state) {
+				const Vec<Token> &t = state.tokens;
+				add_instruction(state, mkuptr<InstructionAssignment>(
+					make_expr(t[1]),
+					make_variable_ref(t[0])
+				));
+			}
+		};
+
+		// shared by the arithmetic and comparison assignments
+		struct AddBinaryAssignment {
+			template<typename ActionInput>
+			static void apply(const ActionInput &, ParseState &state) {
+				const Vec<Token> &t = state.tokens;
+				add_instruction(state, mkuptr<InstructionAssignment>(
+					mkuptr<BinaryOperation>(
+						make_expr(t[1]),
+						make_expr(t[3]),
+						make_operator(t[2])
+					),
+					make_variable_ref(t[0])
+				));
+			}
+		};
+		template<> struct Action<rules::InstructionOpAssignmentRule> : AddBinaryAssignment {};
+		template<> struct Action<rules::InstructionCompareAssignmentRule> : AddBinaryAssignment {};
+
+		template<> struct Action<rules::InstructionLoadAssignmentRule> {
+			template<typename ActionInput>
+			static void apply(const ActionInput &, ParseState &state) {
+				const Vec<Token> &t = state.tokens;
+				add_instruction(state, mkuptr<InstructionAssignment>(
+					mkuptr<MemoryLocation>(
+						make_variable_ref(t[1])
+					),
+					make_variable_ref(t[0])
+				));
+			}
+		};
+
+		template<> struct Action<rules::InstructionStoreAssignmentRule> {
+			template<typename ActionInput>
+			static void apply(const ActionInput &, ParseState &state) {
+				const Vec<Token> &t = state.tokens;
+				add_instruction(state, mkuptr<InstructionStore>(
+					make_expr(t[1]),
+					make_variable_ref(t[0])
+				));
+			}
+		};
+
+		template<> struct Action<rules::InstructionReturnRule> {
+			template<typename ActionInput>
+			static void apply(const ActionInput &, ParseState &state) {
+				const Vec<Token> &t = state.tokens;
+				if (t.empty()) {
+					// return without value
+					add_instruction(state, mkuptr<InstructionReturn>(Opt<Uptr<Expr>>()));
+				} else {
+					// return with value
+					add_instruction(state, mkuptr<InstructionReturn>(make_expr(t[0])));
+				}
+			}
+		};
+
+		template<> struct Action<rules::InstructionLabelRule> {
+			template<typename ActionInput>
+			static void apply(const ActionInput &, ParseState &state) {
+				add_instruction(state, mkuptr<InstructionLabel>(get_name(state.tokens[0])));
+			}
+		};
+
+		template<> struct Action<rules::InstructionBranchUncondRule> {
+			template<typename ActionInput>
+			static void apply(const ActionInput &, ParseState &state) {
+				add_instruction(state, mkuptr<InstructionBranch>(make_label_ref(state.tokens[0])));
+			}
+		};
+
+		template<> struct Action<rules::InstructionBranchCondRule> {
+			template<typename ActionInput>
+			static void apply(const ActionInput &, ParseState &state) {
+				const Vec<Token> &t = state.tokens;
+				add_instruction(state, mkuptr<InstructionBranch>(
+					make_label_ref(t[1]),
+					make_expr(t[0])
+				));
+			}
+		};
+
+		template<> struct Action<rules::InstructionCallVoidRule> {
+			template<typename ActionInput>
+			static void apply(const ActionInput &, ParseState &state) {
+				add_instruction(state, mkuptr<InstructionAssignment>(
+					make_function_call(state.tokens, 0)
+				));
+			}
+		};
+
+		template<> struct Action<rules::InstructionCallValRule> {
+			template<typename ActionInput>
+			static void apply(const ActionInput &, ParseState &state) {
+				const Vec<Token> &t = state.tokens;
+				add_instruction(state, mkuptr<InstructionAssignment>(
+					make_function_call(t, 1),
+					make_variable_ref(t[0])
+				));
+			}
+		};
+
+		// by the time the parameters are matched, the tokens are the function
+		// name followed by the parameters
+		template<> struct Action<rules::DefArgsRule> {
+			template<typename ActionInput>
+			static void apply(const ActionInput &, ParseState &state) {
+				const Vec<Token> &t = state.tokens;
+				state.function_builder->add_name(get_name(t.at(0)).str());
+				for (size_t i = 1; i < t.size(); ++i) {
+					state.function_builder->add_parameter(get_name(t[i]));
+				}
+				state.tokens.clear();
+			}
+		};
+
+		template<> struct Action<rules::FunctionRule> {
+			template<typename ActionInput>
+			static void apply(const ActionInput &, ParseState &state) {
+				auto [function, agg_scope] = state.function_builder->get_result();
+				state.program_builder.add_l3_function(mv(function), agg_scope);
+				state.function_builder.reset();
+			}
+		};
+
+		template<typename Rule, typename... Rules>
+		constexpr bool is_any_of = (std::is_same_v<Rule, Rules> || ...);
+
+		// Actions run as soon as their rule matches, even if an enclosing
+		// rule fails afterwards, so a failed alternative of InstructionRule
+		// can leave stray tokens behind. Every function and instruction
+		// therefore starts out with a fresh state.
+		template<typename Rule>
+		struct Control : pegtl::normal<Rule> {
+			template<typename ParseInput>
+			static void start(const ParseInput &, ParseState &state) {
+				if constexpr (std::is_same_v<Rule, rules::FunctionRule>) {
+					state.function_builder = mkuptr<L3Function::Builder>();
+					state.tokens.clear();
+				} else if constexpr (is_any_of<Rule,
+					rules::InstructionPureAssignmentRule,
+					rules::InstructionOpAssignmentRule,
+					rules::InstructionCompareAssignmentRule,
+					rules::InstructionLoadAssignmentRule,
+					rules::InstructionStoreAssignmentRule,
+					rules::InstructionReturnRule,
+					rules::InstructionLabelRule,
+					rules::InstructionBranchUncondRule,
+					rules::InstructionBranchCondRule,
+					rules::InstructionCallVoidRule,
+					rules::InstructionCallValRule
+				>) {
+					state.tokens.clear();
+				}
+			}
+		};
+	}
+
 	Uptr<L3::program::Program> parse_file(char *fileName, Opt<std::string> parse_tree_output) {
 		using EntryPointRule = pegtl::must<rules::ProgramRule>;
 
@@ -699,23 +964,29 @@ namespace L3::parser {
 			exit(1);
 		}
 
-		// Parse
-		pegtl::file_input<> fileInput(fileName);
-		auto root = pegtl::parse_tree::parse<EntryPointRule, ParseNode, rules::Selector>(fileInput);
-		if (!root) {
-			std::cerr << "ERROR: Parser failed" << std::endl;
-			exit(1);
-		}
+		// Parse. The source is memory-mapped rather than read into a buffer,
+		// and identifiers are interned straight out of the mapping.
+		pegtl::mmap_input<> fileInput(fileName);
 		if (parse_tree_output) {
+			auto root = pegtl::parse_tree::parse<EntryPointRule, ParseNode, rules::Selector>(fileInput);
+			if (!root) {
+				std::cerr << "ERROR: Parser failed" << std::endl;
+				exit(1);
+			}
 			std::ofstream output_fstream(*parse_tree_output);
 			if (output_fstream.is_open()) {
 				pegtl::parse_tree::print_dot(output_fstream, *root);
 				output_fstream.close();
 			}
+			return node_processor::make_program((*root)[0]);
 		}
 
-		Uptr<L3::program::Program> ptr = node_processor::make_program((*root)[0]);
-		return ptr;
+		actions::ParseState state;
+		if (!pegtl::parse<EntryPointRule, actions::Action, actions::Control>(fileInput, state)) {
+			std::cerr << "ERROR: Parser failed" << std::endl;
+			exit(1);
+		}
+		return state.program_builder.get_result();
 
 		// auto p = node_processor::make_program((*root)[0]);
 		// p->get_scope().fake_bind_frees(); // If you want to allow unbound name
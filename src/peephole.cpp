@@ -0,0 +1,129 @@
+#include "peephole.h"
+
+namespace L3::code_gen::peephole {
+	using l2::Instruction;
+	using l2::Opcode;
+	using l2::Operand;
+
+	// A rule matches a window of the last `window_size` instructions emitted
+	// so far. If it matches, it fills `replacement` with the instructions
+	// that the window should become and returns true.
+	struct RuleInfo {
+		std::string_view name;
+		int window_size;
+		bool (*rewrite)(const Instruction *window, Vec<Instruction> &replacement);
+	};
+
+	// whether the operand can be any of the registers of an L2 `w`
+	static bool is_general_register(const Operand &operand) {
+		switch (operand.kind) {
+			case Operand::Kind::variable:
+			case Operand::Kind::temp:
+				return true;
+			case Operand::Kind::reg:
+				return operand.reg != l2::Register::rsp;
+			default:
+				return false;
+		}
+	}
+
+	static bool rewrite_self_move(const Instruction *window, Vec<Instruction> &replacement) {
+		const Instruction &move = window[0];
+		return move.opcode == Opcode::assign && move.operands[0] == move.operands[1];
+	}
+
+	static bool rewrite_move_add_to_lea(const Instruction *window, Vec<Instruction> &replacement) {
+		const Instruction &move = window[0];
+		const Instruction &add = window[1];
+		if (move.opcode != Opcode::assign
+			|| add.opcode != Opcode::assign_op
+			|| add.op != L3::program::Operator::plus)
+		{
+			return false;
+		}
+		const Operand &dest = move.operands[0];
+		const Operand &base = move.operands[1];
+		const Operand &index = add.operands[1];
+		// the addend must be read before the move overwrites it, so it can't
+		// be the destination
+		if (add.operands[0] != dest
+			|| index == dest
+			|| !is_general_register(dest)
+			|| !is_general_register(base)
+			|| !is_general_register(index))
+		{
+			return false;
+		}
+		replacement.push_back(Instruction::make_lea(dest, base, index, 1));
+		return true;
+	}
+
+	static bool rewrite_goto_next_label(const Instruction *window, Vec<Instruction> &replacement) {
+		const Instruction &jump = window[0];
+		const Instruction &label = window[1];
+		if (jump.opcode != Opcode::goto_
+			|| label.opcode != Opcode::label
+			|| jump.operands[0] != label.operands[0])
+		{
+			return false;
+		}
+		replacement.push_back(label);
+		return true;
+	}
+
+	static const RuleInfo rule_infos[NUM_RULES] = {
+		{ "self-move", 1, rewrite_self_move },
+		{ "move-add-to-lea", 2, rewrite_move_add_to_lea },
+		{ "goto-next-label", 2, rewrite_goto_next_label },
+	};
+
+	std::string_view get_rule_name(Rule rule) {
+		return rule_infos[static_cast<int>(rule)].name;
+	}
+
+	RewriteCounts &RewriteCounts::operator+=(const RewriteCounts &other) {
+		for (int i = 0; i < NUM_RULES; ++i) {
+			this->counts[i] += other.counts[i];
+		}
+		return *this;
+	}
+
+	// Tries every rule on the window at the end of `out`. Returns true if
+	// one of them rewrote it.
+	static bool rewrite_tail(Vec<Instruction> &out, Vec<Instruction> &replacement, RewriteCounts &counts) {
+		for (int i = 0; i < NUM_RULES; ++i) {
+			const RuleInfo &rule_info = rule_infos[i];
+			if (out.size() < rule_info.window_size) {
+				continue;
+			}
+			replacement.clear();
+			const Instruction *window = out.data() + out.size() - rule_info.window_size;
+			if (rule_info.rewrite(window, replacement)) {
+				out.resize(out.size() - rule_info.window_size);
+				out.insert(out.end(), replacement.begin(), replacement.end());
+				counts.counts[i] += 1;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	RewriteCounts optimize(l2::Function &function) {
+		RewriteCounts counts;
+
+		// The instructions are moved one at a time onto the end of `out`,
+		// and the window at the end of `out` is rewritten until no rule
+		// matches. Since a rewrite only ever looks backwards, the output of
+		// one rewrite can be matched again by the next instruction that
+		// comes in.
+		Vec<Instruction> out;
+		out.reserve(function.instructions.size());
+		Vec<Instruction> replacement;
+		for (const Instruction &inst : function.instructions) {
+			out.push_back(inst);
+			while (rewrite_tail(out, replacement, counts)) {}
+		}
+		function.instructions = mv(out);
+		return counts;
+	}
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "std_alias.h"
+#include "l2.h"
+#include <array>
+#include <string_view>
+
+// A windowed peephole optimizer over the L2 instructions of a function.
+// Tiles are chosen one tree at a time, so the boundaries between tiles
+// often leave redundant sequences that can be removed or fused once the
+// whole function is laid out.
+namespace L3::code_gen::peephole {
+	using namespace std_alias;
+
+	enum class Rule {
+		self_move, // x <- x
+		move_add_to_lea, // x <- a; x += b  =>  x @ a b 1
+		goto_next_label, // goto :l; :l  =>  :l
+		num_rules
+	};
+	const int NUM_RULES = static_cast<int>(Rule::num_rules);
+
+	std::string_view get_rule_name(Rule rule);
+
+	// how many times each rule rewrote the code
+	struct RewriteCounts {
+		std::array<int, NUM_RULES> counts;
+
+		RewriteCounts() : counts {} {}
+		int &operator[](Rule rule) { return this->counts[static_cast<int>(rule)]; }
+		int operator[](Rule rule) const { return this->counts[static_cast<int>(rule)]; }
+		RewriteCounts &operator+=(const RewriteCounts &other);
+	};
+
+	// Rewrites the function's instructions in place until no rule applies.
+	RewriteCounts optimize(l2::Function &function);
+}
@@ -0,0 +1,216 @@
+#include "pipeline.h"
+#include "analyze_trees.h"
+#include "constant_propagation.h"
+#include "dead_code_elimination.h"
+#include "value_numbering.h"
+#include "loop_invariant_code_motion.h"
+#include "tail_recursion.h"
+#include "branch_simplification.h"
+#include "block_layout.h"
+#include "never_returns.h"
+#include "code_gen.h"
+#include "target_arch.h"
+#include <atomic>
+#include <sstream>
+#include <thread>
+
+namespace L3::pipeline {
+	static const PassInfo pass_infos[NUM_PASSES] = {
+		{ "inlining", 1, false },
+		{ "tail-recursion", 1, false },
+		{ "never-returns", 1, false },
+		{ "constant-propagation", 1, true },
+		{ "branch-simplification", 1, true },
+		{ "value-numbering", 1, false },
+		{ "loop-invariant-code-motion", 1, true },
+		{ "dead-code-elimination", 1, true },
+		{ "merge-trees", 1, true },
+		{ "block-layout", 1, false },
+		{ "optimal-tiling", 2, false },
+		{ "peephole", 1, false },
+	};
+
+	const PassInfo &get_pass_info(Pass pass) {
+		return pass_infos[static_cast<int>(pass)];
+	}
+
+	PassConfig::PassConfig(int optimization_level) {
+		for (int i = 0; i < NUM_PASSES; ++i) {
+			this->enabled[i] = optimization_level >= pass_infos[i].min_optimization_level;
+		}
+	}
+	bool PassConfig::needs_data_flow() const {
+		for (int i = 0; i < NUM_PASSES; ++i) {
+			if (this->enabled[i] && pass_infos[i].needs_data_flow) {
+				return true;
+			}
+		}
+		return false;
+	}
+	bool PassConfig::apply_flag(std::string_view flag) {
+		bool enable = true;
+		if (flag.substr(0, 3) == "no-") {
+			enable = false;
+			flag.remove_prefix(3);
+		}
+		for (int i = 0; i < NUM_PASSES; ++i) {
+			if (pass_infos[i].name == flag) {
+				this->enabled[i] = enable;
+				return true;
+			}
+		}
+		return false;
+	}
+	std::string PassConfig::get_pass_names() {
+		std::string result;
+		for (int i = 0; i < NUM_PASSES; ++i) {
+			if (i > 0) {
+				result += ", ";
+			}
+			result += pass_infos[i].name;
+		}
+		return result;
+	}
+
+	FunctionStats compile_function(
+		L3Function &l3_function,
+		const PassConfig &config,
+		std::ostream &o,
+		const analyze::InlineCandidates *inline_candidates_nullable,
+		timing::PhaseTimes *times_nullable
+	) {
+		using timing::Phase;
+		using timing::ScopedPhaseTimer;
+		FunctionStats stats;
+
+		{
+			ScopedPhaseTimer timer(times_nullable, Phase::build_trees);
+			analyze::generate_computation_trees(l3_function);
+		}
+		if (inline_candidates_nullable) {
+			ScopedPhaseTimer timer(times_nullable, Phase::inline_calls);
+			analyze::inline_calls(l3_function, *inline_candidates_nullable);
+		}
+		if (config.is_enabled(Pass::eliminate_tail_recursion)) {
+			ScopedPhaseTimer timer(times_nullable, Phase::eliminate_tail_recursion);
+			analyze::eliminate_tail_recursion(l3_function);
+		}
+		if (config.is_enabled(Pass::propagate_never_returns)) {
+			// after inlining, which copies the code after the calls too
+			ScopedPhaseTimer timer(times_nullable, Phase::build_trees);
+			analyze::end_blocks_at_never_returning_calls(l3_function);
+		}
+		if (config.needs_data_flow()) {
+			ScopedPhaseTimer timer(times_nullable, Phase::data_flow);
+			stats.num_liveness_iterations = analyze::generate_data_flow(l3_function);
+		}
+		if (config.is_enabled(Pass::propagate_constants)) {
+			ScopedPhaseTimer timer(times_nullable, Phase::propagate_constants);
+			stats.num_liveness_iterations += analyze::propagate_constants(l3_function);
+		}
+		if (config.is_enabled(Pass::simplify_branches)) {
+			ScopedPhaseTimer timer(times_nullable, Phase::simplify_branches);
+			stats.num_liveness_iterations += analyze::simplify_branches(l3_function);
+		}
+		if (config.is_enabled(Pass::number_values)) {
+			ScopedPhaseTimer timer(times_nullable, Phase::number_values);
+			analyze::number_values(l3_function);
+		}
+		if (config.is_enabled(Pass::hoist_loop_invariants)) {
+			ScopedPhaseTimer timer(times_nullable, Phase::hoist_loop_invariants);
+			stats.num_liveness_iterations += analyze::hoist_loop_invariants(l3_function);
+		}
+		if (config.is_enabled(Pass::eliminate_dead_code)) {
+			ScopedPhaseTimer timer(times_nullable, Phase::eliminate_dead_code);
+			stats.num_liveness_iterations += analyze::eliminate_dead_code(l3_function);
+		}
+		if (config.is_enabled(Pass::merge_trees)) {
+			ScopedPhaseTimer timer(times_nullable, Phase::merge_trees);
+			analyze::merge_trees(l3_function);
+		}
+		if (config.is_enabled(Pass::lay_out_blocks)) {
+			ScopedPhaseTimer timer(times_nullable, Phase::lay_out_blocks);
+			analyze::lay_out_blocks(l3_function);
+		}
+
+		code_gen::tiles::TilingStrategy tiling_strategy = config.is_enabled(Pass::optimal_tiling)
+			? code_gen::tiles::TilingStrategy::optimal
+			: code_gen::tiles::TilingStrategy::greedy;
+		code_gen::l2::Function l2_function = code_gen::generate_l2_function(l3_function, tiling_strategy, times_nullable);
+		l3_function.release_computation_trees();
+		if (config.is_enabled(Pass::peephole)) {
+			ScopedPhaseTimer timer(times_nullable, Phase::peephole);
+			stats.peephole_rewrites = code_gen::peephole::optimize(l2_function);
+		}
+
+		ScopedPhaseTimer timer(times_nullable, Phase::emit);
+		code_gen::l2::print_function(o, l2_function);
+		return stats;
+	}
+
+	void compile_program(
+		Program &program,
+		const PassConfig &config,
+		int num_jobs,
+		std::ostream &o,
+		Vec<FunctionStats> &function_stats,
+		Vec<timing::PhaseTimes> *function_times_nullable
+	) {
+		// label mangling touches the whole program so it must happen up front
+		code_gen::target_arch::mangle_label_names(program);
+
+		// every function must know which of its callees never return
+		// before its blocks are built; without this, every L3 function is
+		// assumed to return
+		if (config.is_enabled(Pass::propagate_never_returns)) {
+			analyze::find_never_returning_functions(program);
+		}
+
+		// the candidates must be found before any function's passes run
+		Opt<analyze::InlineCandidates> inline_candidates;
+		if (config.is_enabled(Pass::inline_calls)) {
+			inline_candidates.emplace(program);
+		}
+		const analyze::InlineCandidates *inline_candidates_nullable = inline_candidates ? &*inline_candidates : nullptr;
+
+		Vec<Uptr<L3Function>> &l3_functions = program.get_l3_functions();
+		function_stats.assign(l3_functions.size(), FunctionStats());
+		auto get_times = [&](size_t i) {
+			return function_times_nullable ? &(*function_times_nullable)[i] : nullptr;
+		};
+
+		if (num_jobs <= 1) {
+			code_gen::generate_program_header(program, o);
+			for (size_t i = 0; i < l3_functions.size(); ++i) {
+				function_stats[i] = compile_function(*l3_functions[i], config, o, inline_candidates_nullable, get_times(i));
+			}
+			code_gen::generate_program_footer(o);
+			return;
+		}
+
+		// Every function is independent of the others at this point, so
+		// each worker just claims the next uncompiled function.
+		Vec<std::string> function_codes(l3_functions.size());
+		std::atomic<size_t> next_function_index = 0;
+		auto worker = [&]() {
+			for (size_t i = next_function_index++; i < l3_functions.size(); i = next_function_index++) {
+				std::ostringstream function_o;
+				function_stats[i] = compile_function(*l3_functions[i], config, function_o, inline_candidates_nullable, get_times(i));
+				function_codes[i] = function_o.str();
+			}
+		};
+		Vec<std::thread> threads;
+		for (int i = 0; i < num_jobs; ++i) {
+			threads.emplace_back(worker);
+		}
+		for (std::thread &thread : threads) {
+			thread.join();
+		}
+
+		code_gen::generate_program_header(program, o);
+		for (const std::string &function_code : function_codes) {
+			o << function_code;
+		}
+		code_gen::generate_program_footer(o);
+	}
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "std_alias.h"
+#include "program.h"
+#include "timing.h"
+#include "peephole.h"
+#include "inlining.h"
+#include <array>
+#include <iostream>
+#include <string>
+#include <string_view>
+
+namespace L3::pipeline {
+	using namespace std_alias;
+	using namespace L3::program;
+
+	// The optional passes. Building the computation trees, tiling, and
+	// emitting L2 always happen, so they aren't listed here. The passes on
+	// the trees run before tiling and the passes on the L2 instructions run
+	// after it.
+	enum class Pass {
+		inline_calls,
+		eliminate_tail_recursion,
+		propagate_never_returns,
+		propagate_constants,
+		simplify_branches,
+		number_values,
+		hoist_loop_invariants,
+		eliminate_dead_code,
+		merge_trees,
+		lay_out_blocks,
+		optimal_tiling, // tile with tiles::TilingStrategy::optimal instead of greedily
+		peephole,
+		num_passes
+	};
+	const int NUM_PASSES = static_cast<int>(Pass::num_passes);
+
+	struct PassInfo {
+		std::string_view name; // as written in the -f flag
+		int min_optimization_level; // the lowest -O level that turns the pass on
+		bool needs_data_flow; // whether the pass reads the liveness sets
+	};
+
+	const PassInfo &get_pass_info(Pass pass);
+
+	// Which of the optional passes are turned on.
+	class PassConfig {
+		std::array<bool, NUM_PASSES> enabled;
+
+		public:
+
+		// turns on every pass that the given -O level includes
+		explicit PassConfig(int optimization_level);
+
+		bool is_enabled(Pass pass) const { return this->enabled[static_cast<int>(pass)]; }
+		bool needs_data_flow() const;
+
+		// Applies a flag of the form "PASS" or "no-PASS". Returns false if
+		// there is no pass by that name.
+		bool apply_flag(std::string_view flag);
+
+		// the names of all the passes, for error messages
+		static std::string get_pass_names();
+	};
+
+	// counters collected while compiling a single function
+	struct FunctionStats {
+		int num_liveness_iterations;
+		code_gen::peephole::RewriteCounts peephole_rewrites;
+
+		FunctionStats() : num_liveness_iterations { 0 } {}
+	};
+
+	// Runs the passes on a function and writes its L2 code to `o`, then
+	// frees its computation trees. The label names of the program must
+	// already have been mangled. Calls are inlined if
+	// `inline_candidates_nullable` is given. If `times_nullable` is given,
+	// the time spent in each phase is added to it.
+	FunctionStats compile_function(
+		L3Function &l3_function,
+		const PassConfig &config,
+		std::ostream &o,
+		const analyze::InlineCandidates *inline_candidates_nullable,
+		timing::PhaseTimes *times_nullable
+	);
+
+	// Compiles every function of the program and writes the L2 program to
+	// `o`. With more than one job, the functions are compiled on a pool of
+	// worker threads, each into its own buffer, so the output is the same
+	// as with a serial compile. `function_stats` is filled in parallel to
+	// Program::get_l3_functions(), and so is `function_times_nullable` if
+	// it's given.
+	void compile_program(
+		Program &program,
+		const PassConfig &config,
+		int num_jobs,
+		std::ostream &o,
+		Vec<FunctionStats> &function_stats,
+		Vec<timing::PhaseTimes> *function_times_nullable
+	);
+}
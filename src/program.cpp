@@ -19,12 +19,12 @@ namespace L3::program {
 	template<> void ItemRef<Variable>::bind_to_scope(AggregateScope &agg_scope) {
 		agg_scope.variable_scope.add_ref(*this);
 	}
-	template<> Uptr<ComputationNode> ItemRef<Variable>::to_computation_tree() const {
+	template<> ArenaUptr<ComputationNode> ItemRef<Variable>::to_computation_tree(Arena &arena) const {
 		if (!this->referent_nullable) {
 			std::cerr << "Error: can't convert free variable name to computation tree.\n";
 			exit(1);
 		}
-		return mkuptr<VariableCn>(this->referent_nullable);
+		return arena.make<VariableCn>(this->referent_nullable);
 	}
 	template<> std::string ItemRef<BasicBlock>::to_string() const {
 		std::string result = ":" + this->get_ref_name();
@@ -36,12 +36,12 @@ namespace L3::program {
 	template<> void ItemRef<BasicBlock>::bind_to_scope(AggregateScope &agg_scope) {
 		agg_scope.label_scope.add_ref(*this);
 	}
-	template<> Uptr<ComputationNode> ItemRef<BasicBlock>::to_computation_tree() const {
+	template<> ArenaUptr<ComputationNode> ItemRef<BasicBlock>::to_computation_tree(Arena &arena) const {
 		if (!this->referent_nullable) {
 			std::cerr << "Error: can't convert free label name to computation tree.\n";
 			exit(1);
 		}
-		return mkuptr<LabelCn>(this->referent_nullable);
+		return arena.make<LabelCn>(this->referent_nullable);
 	}
 	template<> std::string ItemRef<L3Function>::to_string() const {
 		std::string result = "@" + this->get_ref_name();
@@ -53,12 +53,12 @@ namespace L3::program {
 	template<> void ItemRef<L3Function>::bind_to_scope(AggregateScope &agg_scope) {
 		agg_scope.l3_function_scope.add_ref(*this);
 	}
-	template<> Uptr<ComputationNode> ItemRef<L3Function>::to_computation_tree() const {
+	template<> ArenaUptr<ComputationNode> ItemRef<L3Function>::to_computation_tree(Arena &arena) const {
 		if (!this->referent_nullable) {
 			std::cerr << "Error: can't convert free L3 function name to computation tree.\n";
 			exit(1);
 		}
-		return mkuptr<FunctionCn>(this->referent_nullable);
+		return arena.make<FunctionCn>(this->referent_nullable);
 	}
 	template<> std::string ItemRef<ExternalFunction>::to_string() const {
 		std::string result = this->get_ref_name();
@@ -70,12 +70,12 @@ namespace L3::program {
 	template<> void ItemRef<ExternalFunction>::bind_to_scope(AggregateScope &agg_scope) {
 		agg_scope.external_function_scope.add_ref(*this);
 	}
-	template<> Uptr<ComputationNode> ItemRef<ExternalFunction>::to_computation_tree() const {
+	template<> ArenaUptr<ComputationNode> ItemRef<ExternalFunction>::to_computation_tree(Arena &arena) const {
 		if (!this->referent_nullable) {
 			std::cerr << "Error: can't convert free external function name to computation tree.\n";
 			exit(1);
 		}
-		return mkuptr<FunctionCn>(this->referent_nullable);
+		return arena.make<FunctionCn>(this->referent_nullable);
 	}
 
 	NumberLiteral::NumberLiteral(std::string_view value_str) :
@@ -84,8 +84,8 @@ namespace L3::program {
 	void NumberLiteral::bind_to_scope(AggregateScope &agg_scope) {
 		// empty bc literals make no reference to names
 	}
-	Uptr<ComputationNode> NumberLiteral::to_computation_tree() const {
-		return mkuptr<NumberCn>(this->value);
+	ArenaUptr<ComputationNode> NumberLiteral::to_computation_tree(Arena &arena) const {
+		return arena.make<NumberCn>(this->value);
 	}
 	std::string NumberLiteral::to_string() const {
 		return std::to_string(this->value);
@@ -94,10 +94,10 @@ namespace L3::program {
 	void MemoryLocation::bind_to_scope(AggregateScope &agg_scope) {
 		this->base->bind_to_scope(agg_scope);
 	}
-	Uptr<ComputationNode> MemoryLocation::to_computation_tree() const {
-		return mkuptr<LoadCn>(
+	ArenaUptr<ComputationNode> MemoryLocation::to_computation_tree(Arena &arena) const {
+		return arena.make<LoadCn>(
 			Opt<Variable *>(),
-			this->base->to_computation_tree()
+			this->base->to_computation_tree(arena)
 		);
 	}
 	std::string MemoryLocation::to_string() const {
@@ -145,17 +145,42 @@ namespace L3::program {
 			default: return {};
 		}
 	}
+	bool is_arithmetic_operator(Operator op) {
+		switch (op) {
+			case Operator::plus:
+			case Operator::minus:
+			case Operator::times:
+			case Operator::bitwise_and:
+			case Operator::lshift:
+			case Operator::rshift:
+				return true;
+			default:
+				return false;
+		}
+	}
+	bool is_comparison_operator(Operator op) {
+		switch (op) {
+			case Operator::lt:
+			case Operator::le:
+			case Operator::eq:
+			case Operator::ge:
+			case Operator::gt:
+				return true;
+			default:
+				return false;
+		}
+	}
 
 	void BinaryOperation::bind_to_scope(AggregateScope &agg_scope) {
 		this->lhs->bind_to_scope(agg_scope);
 		this->rhs->bind_to_scope(agg_scope);
 	}
-	Uptr<ComputationNode> BinaryOperation::to_computation_tree() const {
-		return mkuptr<BinaryCn>(
+	ArenaUptr<ComputationNode> BinaryOperation::to_computation_tree(Arena &arena) const {
+		return arena.make<BinaryCn>(
 			Opt<Variable *>(),
 			this->op,
-			this->lhs->to_computation_tree(),
-			this->rhs->to_computation_tree()
+			this->lhs->to_computation_tree(arena),
+			this->rhs->to_computation_tree(arena)
 		);
 	}
 	std::string BinaryOperation::to_string() const {
@@ -170,14 +195,14 @@ namespace L3::program {
 			arg->bind_to_scope(agg_scope);
 		}
 	}
-	Uptr<ComputationNode> FunctionCall::to_computation_tree() const {
-		Vec<Uptr<ComputationNode>> arguments;
+	ArenaUptr<ComputationNode> FunctionCall::to_computation_tree(Arena &arena) const {
+		Vec<ArenaUptr<ComputationNode>> arguments;
 		for (const Uptr<Expr> &argument : this->arguments) {
-			arguments.emplace_back(argument->to_computation_tree());
+			arguments.emplace_back(argument->to_computation_tree(arena));
 		}
-		return mkuptr<CallCn>(
+		return arena.make<CallCn>(
 			Opt<Variable *>(),
-			this->callee->to_computation_tree(),
+			this->callee->to_computation_tree(arena),
 			mv(arguments)
 		);
 	}
@@ -195,13 +220,13 @@ namespace L3::program {
 			(*this->return_value)->bind_to_scope(agg_scope);
 		}
 	}
-	Uptr<ComputationNode> InstructionReturn::to_computation_tree() const {
+	ArenaUptr<ComputationNode> InstructionReturn::to_computation_tree(Arena &arena) const {
 		if (this->return_value) {
-			return mkuptr<ReturnCn>(
-				(*this->return_value)->to_computation_tree()
+			return arena.make<ReturnCn>(
+				(*this->return_value)->to_computation_tree(arena)
 			);
 		} else {
-			return mkuptr<ReturnCn>();
+			return arena.make<ReturnCn>();
 		}
 	}
 	std::string InstructionReturn::to_string() const {
@@ -218,8 +243,8 @@ namespace L3::program {
 		}
 		this->source->bind_to_scope(agg_scope);
 	}
-	Uptr<ComputationNode> InstructionAssignment::to_computation_tree() const {
-		Uptr<ComputationNode> tree = this->source->to_computation_tree();
+	ArenaUptr<ComputationNode> InstructionAssignment::to_computation_tree(Arena &arena) const {
+		ArenaUptr<ComputationNode> tree = this->source->to_computation_tree(arena);
 		// put a destination on the top node; or make a MoveCn if
 		// there already is a destination there
 		if (!tree->destination.has_value()) {
@@ -229,7 +254,7 @@ namespace L3::program {
 			return mv(tree);
 		} else {
 			// make a MoveCn
-			return mkuptr<MoveCn>(
+			return arena.make<MoveCn>(
 				(*this->maybe_dest)->get_referent().value(), // .value() to assert that there must be a destination; otherwise what's the point (all possibility of side effects was handled in the branch checking if the tree was a ComputationNode)
 				mv(tree)
 			);
@@ -256,10 +281,10 @@ namespace L3::program {
 		this->base->bind_to_scope(agg_scope);
 		this->source->bind_to_scope(agg_scope);
 	}
-	Uptr<ComputationNode> InstructionStore::to_computation_tree() const {
-		return mkuptr<StoreCn>(
-			this->base->to_computation_tree(),
-			this->source->to_computation_tree()
+	ArenaUptr<ComputationNode> InstructionStore::to_computation_tree(Arena &arena) const {
+		return arena.make<StoreCn>(
+			this->base->to_computation_tree(arena),
+			this->source->to_computation_tree(arena)
 		);
 	}
 	Instruction::ControlFlowResult InstructionStore::get_control_flow() const {
@@ -274,12 +299,12 @@ namespace L3::program {
 	}
 
 	void InstructionLabel::bind_to_scope(AggregateScope &agg_scope) {}
-	Uptr<ComputationNode> InstructionLabel::to_computation_tree() const {
+	ArenaUptr<ComputationNode> InstructionLabel::to_computation_tree(Arena &arena) const {
 		// InstructionLabels don't do anything, so output a no-op tree
-		return mkuptr<NoOpCn>();
+		return arena.make<NoOpCn>();
 	}
 	std::string InstructionLabel::to_string() const {
-		return ":" + this->label_name;
+		return ":" + this->label_name.str();
 	}
 
 	void InstructionBranch::bind_to_scope(AggregateScope &agg_scope) {
@@ -295,12 +320,12 @@ namespace L3::program {
 			this->label.get()
 		};
 	}
-	Uptr<ComputationNode> InstructionBranch::to_computation_tree() const {
-		Opt<Uptr<ComputationNode>> condition_tree;
+	ArenaUptr<ComputationNode> InstructionBranch::to_computation_tree(Arena &arena) const {
+		Opt<ArenaUptr<ComputationNode>> condition_tree;
 		if (this->condition) {
-			condition_tree = (*this->condition)->to_computation_tree();
+			condition_tree = (*this->condition)->to_computation_tree(arena);
 		}
-		return mkuptr<BranchCn>(
+		return arena.make<BranchCn>(
 			this->label->get_referent().value(), // .value() to assert that the value exists
 			mv(condition_tree)
 		);
@@ -314,7 +339,7 @@ namespace L3::program {
 		return result;
 	}
 
-	Vec<Uptr<ComputationNode> *> get_merge_targets(Uptr<ComputationNode> &tree, Variable *target) {
+	Vec<ArenaUptr<ComputationNode> *> get_merge_targets(ArenaUptr<ComputationNode> &tree, Variable *target) {
 		// we must replace a variable node with the potential merge child
 		if (VariableCn *var_node = dynamic_cast<VariableCn *>(tree.get())) {
 			if (var_node->destination == target) {
@@ -335,7 +360,7 @@ namespace L3::program {
 	Opt<Variable *> ComputationNode::get_var_written() const {
 		return this->destination;
 	}
-	Vec<Uptr<ComputationNode> *> get_merge_targets(Variable *target) {
+	Vec<ArenaUptr<ComputationNode> *> get_merge_targets(Variable *target) {
 		return {};
 	}
 	std::string NoOpCn::to_string() const {
@@ -346,7 +371,7 @@ namespace L3::program {
 	Set<Variable *> NoOpCn::get_vars_read() const {
 		return {};
 	}
-	Vec<Uptr<ComputationNode> *> NoOpCn::get_merge_targets(Variable *target) {
+	Vec<ArenaUptr<ComputationNode> *> NoOpCn::get_merge_targets(Variable *target) {
 		return {};
 	}
 	std::string NumberCn::to_string() const {
@@ -363,7 +388,7 @@ namespace L3::program {
 	Set<Variable *> NumberCn::get_vars_read() const {
 		return {};
 	}
-	Vec<Uptr<ComputationNode> *> NumberCn::get_merge_targets(Variable *target) {
+	Vec<ArenaUptr<ComputationNode> *> NumberCn::get_merge_targets(Variable *target) {
 		return {};
 	}
 	std::string VariableCn::to_string() const {
@@ -372,7 +397,7 @@ namespace L3::program {
 	Set<Variable *> VariableCn::get_vars_read() const {
 		return { *this->destination };
 	}
-	Vec<Uptr<ComputationNode> *> VariableCn::get_merge_targets(Variable *target) {
+	Vec<ArenaUptr<ComputationNode> *> VariableCn::get_merge_targets(Variable *target) {
 		// we should never get here because the parent should've already return
 		// the Uptr to this VariableCn as the merge target, not recursing into
 		// VariableCn
@@ -393,7 +418,7 @@ namespace L3::program {
 	Set<Variable *> FunctionCn::get_vars_read() const {
 		return {};
 	}
-	Vec<Uptr<ComputationNode> *> FunctionCn::get_merge_targets(Variable *target) {
+	Vec<ArenaUptr<ComputationNode> *> FunctionCn::get_merge_targets(Variable *target) {
 		return {};
 	}
 	std::string LabelCn::to_string() const {
@@ -410,7 +435,7 @@ namespace L3::program {
 	Set<Variable *> LabelCn::get_vars_read() const {
 		return {};
 	}
-	Vec<Uptr<ComputationNode> *> LabelCn::get_merge_targets(Variable *target) {
+	Vec<ArenaUptr<ComputationNode> *> LabelCn::get_merge_targets(Variable *target) {
 		return {};
 	}
 	std::string MoveCn::to_string() const {
@@ -423,7 +448,7 @@ namespace L3::program {
 	Set<Variable*> MoveCn::get_vars_read() const {
 		return this->source->get_vars_read();
 	}
-	Vec<Uptr<ComputationNode> *> MoveCn::get_merge_targets(Variable *target) {
+	Vec<ArenaUptr<ComputationNode> *> MoveCn::get_merge_targets(Variable *target) {
 		return program::get_merge_targets(this->source, target);
 	}
 	std::string BinaryCn::to_string() const {
@@ -443,9 +468,9 @@ namespace L3::program {
 		result.merge(this->rhs->get_vars_read());
 		return result;
 	}
-	Vec<Uptr<ComputationNode> *> BinaryCn::get_merge_targets(Variable *target){
-		Vec<Uptr<ComputationNode> *> sol = program::get_merge_targets(this->lhs, target);
-		Vec<Uptr<ComputationNode> *> rhs_sol = program::get_merge_targets(this->rhs, target);
+	Vec<ArenaUptr<ComputationNode> *> BinaryCn::get_merge_targets(Variable *target){
+		Vec<ArenaUptr<ComputationNode> *> sol = program::get_merge_targets(this->lhs, target);
+		Vec<ArenaUptr<ComputationNode> *> rhs_sol = program::get_merge_targets(this->rhs, target);
 		sol += rhs_sol;
 		return sol;
 	}
@@ -455,22 +480,22 @@ namespace L3::program {
 			+ ") CallCn { "
 			+ this->callee->to_string()
 			+ ", [";
-		for (const Uptr<ComputationNode> &tree : this->arguments) {
+		for (const ArenaUptr<ComputationNode> &tree : this->arguments) {
 			result += tree->to_string() + ", ";
 		}
 		result += "] }";
 		return result;
 	}
 	Set<Variable *> CallCn::get_vars_read() const {
-		Set<Variable *> sol;
-		for (const Uptr<ComputationNode> &computation_tree: arguments) {
+		Set<Variable *> sol = this->callee->get_vars_read();
+		for (const ArenaUptr<ComputationNode> &computation_tree: arguments) {
 			sol.merge(computation_tree->get_vars_read());
 		}
 		return sol;
 	}
-	Vec<Uptr<ComputationNode> *> CallCn::get_merge_targets(Variable *target) {
-		Vec<Uptr<ComputationNode> *> sol;
-		for (Uptr<ComputationNode> &computation_tree : this->arguments) {
+	Vec<ArenaUptr<ComputationNode> *> CallCn::get_merge_targets(Variable *target) {
+		Vec<ArenaUptr<ComputationNode> *> sol;
+		for (ArenaUptr<ComputationNode> &computation_tree : this->arguments) {
 			sol += program::get_merge_targets(computation_tree, target);
 		}
 		return sol;
@@ -485,7 +510,7 @@ namespace L3::program {
 	Set<Variable *> LoadCn::get_vars_read() const {
 		return this->address->get_vars_read();
 	}
-	Vec<Uptr<ComputationNode> *> LoadCn::get_merge_targets(Variable *target) {
+	Vec<ArenaUptr<ComputationNode> *> LoadCn::get_merge_targets(Variable *target) {
 		return program::get_merge_targets(this->address, target);
 	}
 	std::string StoreCn::to_string() const {
@@ -503,9 +528,9 @@ namespace L3::program {
 		sol.merge(this->value->get_vars_read());
 		return sol;
 	}
-	Vec<Uptr<ComputationNode> *> StoreCn::get_merge_targets(Variable *target) {
-		Vec<Uptr<ComputationNode> *> sol = program::get_merge_targets(this->address, target);
-		Vec<Uptr<ComputationNode> *> value_sol = program::get_merge_targets(this->value, target);
+	Vec<ArenaUptr<ComputationNode> *> StoreCn::get_merge_targets(Variable *target) {
+		Vec<ArenaUptr<ComputationNode> *> sol = program::get_merge_targets(this->address, target);
+		Vec<ArenaUptr<ComputationNode> *> value_sol = program::get_merge_targets(this->value, target);
 		sol += value_sol;
 		return sol;
 	}
@@ -515,7 +540,7 @@ namespace L3::program {
 			+ ") BranchCn { "
 			+ program::to_string(this->jmp_dest)
 			+ ", "
-			+ utils::to_string<Uptr<ComputationNode>, program::to_string>(this->condition)
+			+ utils::to_string<ArenaUptr<ComputationNode>, program::to_string>(this->condition)
 			+ " }";
 	}
 	Set<Variable *> BranchCn::get_vars_read() const {
@@ -524,7 +549,7 @@ namespace L3::program {
 		}
 		return Set<Variable *>();
 	}
-	Vec<Uptr<ComputationNode> *> BranchCn::get_merge_targets(Variable *target) {
+	Vec<ArenaUptr<ComputationNode> *> BranchCn::get_merge_targets(Variable *target) {
 		if (this->condition.has_value()){
 			return program::get_merge_targets(*this->condition, target);
 		}
@@ -534,7 +559,7 @@ namespace L3::program {
 		return "("
 			+ utils::to_string<Variable *, program::to_string>(this->destination)
 			+ ") ReturnCn { "
-			+ utils::to_string<Uptr<ComputationNode>, program::to_string>(this->value)
+			+ utils::to_string<ArenaUptr<ComputationNode>, program::to_string>(this->value)
 			+ " }";
 	}
 	Set<Variable *> ReturnCn::get_vars_read() const {
@@ -543,21 +568,26 @@ namespace L3::program {
 		}
 		return Set<Variable *>();
 	}
-	Vec<Uptr<ComputationNode> *> ReturnCn::get_merge_targets(Variable *target) {
+	Vec<ArenaUptr<ComputationNode> *> ReturnCn::get_merge_targets(Variable *target) {
 		if (this->value.has_value()) {
 			return program::get_merge_targets(*this->value, target);
 		}
 		return {};
 	}
-	std::string to_string(const Uptr<ComputationNode> &node) {
+	std::string to_string(const ArenaUptr<ComputationNode> &node) {
 		return node->to_string();
 	}
 	std::string to_string(const ComputationNode &node) {
 		return node.to_string();
 	}
 
-	ComputationTreeBox::ComputationTreeBox(const Instruction &inst) :
-		root_nullable { inst.to_computation_tree() },
+	ComputationTreeBox::ComputationTreeBox(const Instruction &inst, Arena &arena) :
+		root_nullable { inst.to_computation_tree(arena) },
+		has_load { static_cast<bool>(dynamic_cast<LoadCn *>(this->root_nullable.get())) },
+		has_store { static_cast<bool>(dynamic_cast<StoreCn *>(this->root_nullable.get())) }
+	{}
+	ComputationTreeBox::ComputationTreeBox(ArenaUptr<ComputationNode> root) :
+		root_nullable { mv(root) },
 		has_load { static_cast<bool>(dynamic_cast<LoadCn *>(this->root_nullable.get())) },
 		has_store { static_cast<bool>(dynamic_cast<StoreCn *>(this->root_nullable.get())) }
 	{}
@@ -568,7 +598,7 @@ namespace L3::program {
 		}
 		Variable *var = *other.get_var_written();
 
-		Vec<Uptr<ComputationNode> *> merge_targets = this->root_nullable->get_merge_targets(var);
+		Vec<ArenaUptr<ComputationNode> *> merge_targets = this->root_nullable->get_merge_targets(var);
 		if (merge_targets.size() != 1) {
 			// FUTURE I don't know how to merge if there is more than one merge target
 			return false;
@@ -583,8 +613,8 @@ namespace L3::program {
 			this->has_store = true;
 		}
 
-		Uptr<ComputationNode> *merge_target = merge_targets[0];
-		Uptr<ComputationNode> *merge_child = &other.root_nullable;
+		ArenaUptr<ComputationNode> *merge_target = merge_targets[0];
+		ArenaUptr<ComputationNode> *merge_child = &other.root_nullable;
 		if (MoveCn *move_node = dynamic_cast<MoveCn *>(merge_child->get())) {
 			// optimize away a child move node; e.g. a <- b <- c becomes a <- c
 			merge_child = &move_node->source;
@@ -597,9 +627,102 @@ namespace L3::program {
 		return true;
 	}
 
+	VarSet::Iterator::Iterator(const VarSet *set, size_t word_index) :
+		set { set },
+		word_index { word_index },
+		remaining_bits { word_index < set->words.size() ? set->words[word_index] : 0 }
+	{
+		this->skip_empty_words();
+	}
+	Variable *VarSet::Iterator::operator*() const {
+		size_t index = this->word_index * WORD_BITS + __builtin_ctzll(this->remaining_bits);
+		return (*this->set->variables_nullable)[index].get();
+	}
+	VarSet::Iterator &VarSet::Iterator::operator++() {
+		this->remaining_bits &= this->remaining_bits - 1; // clear the lowest set bit
+		this->skip_empty_words();
+		return *this;
+	}
+	void VarSet::Iterator::skip_empty_words() {
+		while (this->remaining_bits == 0 && this->word_index < this->set->words.size()) {
+			this->word_index += 1;
+			if (this->word_index < this->set->words.size()) {
+				this->remaining_bits = this->set->words[this->word_index];
+			}
+		}
+	}
+	void VarSet::insert(const Variable *var) {
+		size_t word_index = var->get_index() / WORD_BITS;
+		if (word_index >= this->words.size()) {
+			// the variable was added to the function after this set was made
+			this->words.resize(word_index + 1, 0);
+		}
+		this->words[word_index] |= Word(1) << (var->get_index() % WORD_BITS);
+	}
+	void VarSet::erase(const Variable *var) {
+		size_t word_index = var->get_index() / WORD_BITS;
+		if (word_index < this->words.size()) {
+			this->words[word_index] &= ~(Word(1) << (var->get_index() % WORD_BITS));
+		}
+	}
+	bool VarSet::contains(const Variable *var) const {
+		size_t word_index = var->get_index() / WORD_BITS;
+		return word_index < this->words.size()
+			&& (this->words[word_index] >> (var->get_index() % WORD_BITS)) & 1;
+	}
+	bool VarSet::empty() const {
+		for (Word word : this->words) {
+			if (word) {
+				return false;
+			}
+		}
+		return true;
+	}
+	void VarSet::clear() {
+		std::fill(this->words.begin(), this->words.end(), 0);
+	}
+	VarSet &VarSet::operator|=(const VarSet &other) {
+		if (!this->variables_nullable) {
+			this->variables_nullable = other.variables_nullable;
+		}
+		if (other.words.size() > this->words.size()) {
+			this->words.resize(other.words.size(), 0);
+		}
+		Word *dest = this->words.data();
+		const Word *source = other.words.data();
+		for (size_t i = 0; i < other.words.size(); ++i) {
+			dest[i] |= source[i];
+		}
+		return *this;
+	}
+	VarSet &VarSet::operator-=(const VarSet &other) {
+		size_t n = std::min(this->words.size(), other.words.size());
+		Word *dest = this->words.data();
+		const Word *source = other.words.data();
+		for (size_t i = 0; i < n; ++i) {
+			dest[i] &= ~source[i];
+		}
+		return *this;
+	}
+	bool VarSet::operator==(const VarSet &other) const {
+		// sets made at different times may have different numbers of words;
+		// the missing words are all zeroes
+		const Vec<Word> &shorter = this->words.size() < other.words.size() ? this->words : other.words;
+		const Vec<Word> &longer = this->words.size() < other.words.size() ? other.words : this->words;
+		Word difference = 0;
+		for (size_t i = 0; i < shorter.size(); ++i) {
+			difference |= shorter[i] ^ longer[i];
+		}
+		for (size_t i = shorter.size(); i < longer.size(); ++i) {
+			difference |= longer[i];
+		}
+		return difference == 0;
+	}
+
 	BasicBlock::BasicBlock() {} // default-initialize everything
-	// implementations for BasicBlock::generate_computation_trees and
-	// update_in_out_sets are in analyze_trees.cpp
+	// implementations for BasicBlock::generate_computation_trees,
+	// update_in_out_sets, falls_through, generate_succ_blocks, and
+	// replace_succ_block are in analyze_trees.cpp
 	std::string BasicBlock::to_string() const {
 		std::string result = "-----\n";
 		result += "in: ";
@@ -638,10 +761,10 @@ namespace L3::program {
 
 		return mv(this->fetus);
 	}
-	Pair<BasicBlock *, Opt<std::string>> BasicBlock::Builder::get_fetus_and_name() {
+	Pair<BasicBlock *, Opt<Symbol>> BasicBlock::Builder::get_fetus_and_name() {
 		return {
 			this->fetus.get(),
-			this->fetus->get_name().size() > 0 ? this->fetus->get_name() : Opt<std::string>()
+			this->fetus->get_name().size() > 0 ? Symbol::intern(this->fetus->get_name()) : Opt<Symbol>()
 		};
 	}
 	bool BasicBlock::Builder::add_next_instruction(Uptr<Instruction> &&inst) {
@@ -656,9 +779,11 @@ namespace L3::program {
 				return false;
 			}
 		}
+		// a call comes back to the next instruction, so it stays in the
+		// block like any other instruction
 		auto [falls_through, yields_control, jmp_dest] = inst->get_control_flow();
 		this->falls_through = falls_through;
-		if (!falls_through || yields_control) {
+		if (!falls_through) {
 			this->must_end = true;
 		}
 		if (jmp_dest) {
@@ -668,6 +793,16 @@ namespace L3::program {
 		this->fetus->raw_instructions.push_back(mv(inst));
 		return true;
 	}
+	void BasicBlock::generate_pred_blocks(const Vec<Uptr<BasicBlock>> &blocks) {
+		for (const Uptr<BasicBlock> &block : blocks) {
+			block->pred_blocks.clear();
+		}
+		for (const Uptr<BasicBlock> &block : blocks) {
+			for (BasicBlock *succ : block->succ_blocks) {
+				succ->pred_blocks.push_back(block.get());
+			}
+		}
+	}
 	std::string to_string(BasicBlock *const &block) {
 		return block->get_name();
 	}
@@ -680,13 +815,28 @@ namespace L3::program {
 	}
 
 	std::string Variable::to_string() const {
-		return "%" + this->name;
+		return "%" + this->name.str();
 	}
 
 	std::string to_string(Variable *const &variable) {
 		return variable->to_string();
 	}
 
+	void L3Function::release_computation_trees() {
+		for (Uptr<BasicBlock> &block : this->blocks) {
+			block->clear_computation_trees();
+		}
+		for (Uptr<BasicBlock> &block : this->removed_blocks) {
+			block->clear_computation_trees();
+		}
+		this->node_arena.release();
+	}
+	Variable *L3Function::add_variable(std::string_view name) {
+		Uptr<Variable> var_ptr = mkuptr<Variable>(Symbol::intern(name), this->vars.size());
+		Variable *var = var_ptr.get();
+		this->vars.push_back(mv(var_ptr));
+		return var;
+	}
 	bool L3Function::verify_argument_num(int num) const {
 		return num == this->parameter_vars.size();
 	}
@@ -712,7 +862,7 @@ namespace L3::program {
 		for (BasicBlock::Builder &builder : this->block_builders) {
 			auto [block_ptr, maybe_name] = builder.get_fetus_and_name();
 			if (maybe_name) {
-				this->agg_scope.label_scope.resolve_item(mv(*maybe_name), block_ptr);
+				this->agg_scope.label_scope.resolve_item(*maybe_name, block_ptr);
 			}
 		}
 
@@ -727,11 +877,12 @@ namespace L3::program {
 			next_block_nullable = temp;
 		}
 		std::reverse(blocks.begin(), blocks.end());
+		BasicBlock::generate_pred_blocks(blocks);
 
 		// bind all unbound variables to new variable items
-		for (std::string name : this->agg_scope.variable_scope.get_free_names()) {
-			Uptr<Variable> var_ptr = mkuptr<Variable>(name);
-			this->agg_scope.variable_scope.resolve_item(mv(name), var_ptr.get());
+		for (Symbol name : this->agg_scope.variable_scope.get_free_names()) {
+			Uptr<Variable> var_ptr = mkuptr<Variable>(name, this->vars.size());
+			this->agg_scope.variable_scope.resolve_item(name, var_ptr.get());
 			this->vars.emplace_back(mv(var_ptr));
 		}
 
@@ -761,9 +912,9 @@ namespace L3::program {
 			assert(success);
 		}
 	}
-	void L3Function::Builder::add_parameter(std::string var_name) {
-		Uptr<Variable> var_ptr = mkuptr<Variable>(var_name);
-		this->agg_scope.variable_scope.resolve_item(mv(var_name), var_ptr.get());
+	void L3Function::Builder::add_parameter(Symbol var_name) {
+		Uptr<Variable> var_ptr = mkuptr<Variable>(var_name, this->vars.size());
+		this->agg_scope.variable_scope.resolve_item(var_name, var_ptr.get());
 		this->parameter_vars.push_back(var_ptr.get());
 		this->vars.emplace_back(mv(var_ptr));
 	}
@@ -794,11 +945,11 @@ namespace L3::program {
 	}
 	Program::Builder::Builder() :
 		// default-construct everything else
-		main_function_ref { mkuptr<ItemRef<L3Function>>("main") }
+		main_function_ref { mkuptr<ItemRef<L3Function>>(Symbol::intern("main")) }
 	{
 		for (Uptr<ExternalFunction> &function_ptr : generate_std_functions()) {
 			this->agg_scope.external_function_scope.resolve_item(
-				function_ptr->get_name(),
+				Symbol::intern(function_ptr->get_name()),
 				function_ptr.get()
 			);
 			this->external_functions.emplace_back(mv(function_ptr));
@@ -817,17 +968,20 @@ namespace L3::program {
 	}
 	void Program::Builder::add_l3_function(Uptr<L3Function> &&function, AggregateScope &fun_scope) {
 		fun_scope.set_parent(this->agg_scope);
-		this->agg_scope.l3_function_scope.resolve_item(function->get_name(), function.get());
+		this->agg_scope.l3_function_scope.resolve_item(Symbol::intern(function->get_name()), function.get());
 		this->l3_functions.push_back(mv(function));
 	}
 
 	Vec<Uptr<ExternalFunction>> generate_std_functions() {
 		Vec<Uptr<ExternalFunction>> result;
-		result.push_back(mkuptr<ExternalFunction>("input", Vec<int> { 0 }));
-		result.push_back(mkuptr<ExternalFunction>("print", Vec<int> { 1 }));
-		result.push_back(mkuptr<ExternalFunction>("allocate", Vec<int> { 2 }));
-		result.push_back(mkuptr<ExternalFunction>("tuple-error", Vec<int> { 3 }));
-		result.push_back(mkuptr<ExternalFunction>("tensor-error", Vec<int> { 1, 3, 4 }));
+		// the effects are { reads_memory, writes_memory, allocates, never_returns };
+		// print reads the elements of an array it is given, and allocate
+		// only writes the memory it returns
+		result.push_back(mkuptr<ExternalFunction>("input", Vec<int> { 0 }, FunctionEffects { false, false, false, false }));
+		result.push_back(mkuptr<ExternalFunction>("print", Vec<int> { 1 }, FunctionEffects { true, false, false, false }));
+		result.push_back(mkuptr<ExternalFunction>("allocate", Vec<int> { 2 }, FunctionEffects { false, false, true, false }));
+		result.push_back(mkuptr<ExternalFunction>("tuple-error", Vec<int> { 3 }, FunctionEffects { true, false, false, true }));
+		result.push_back(mkuptr<ExternalFunction>("tensor-error", Vec<int> { 1, 3, 4 }, FunctionEffects { true, false, false, true }));
 		return result;
 	}
 }
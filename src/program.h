@@ -1,6 +1,8 @@
 #pragma once
 
 #include "std_alias.h"
+#include "arena.h"
+#include "symbol.h"
 #include <string>
 #include <string_view>
 #include <iostream>
@@ -9,6 +11,8 @@
 
 namespace L3::program {
 	using namespace std_alias;
+	using arena::Arena;
+	using arena::ArenaUptr;
 
 	// TODO rename `Builder` classes to `Mother` and `get_result` to `birth`
 
@@ -45,7 +49,7 @@ namespace L3::program {
 		// virtual Set<Variable *> get_vars_on_read() const { return {}; }
 		// virtual Set<Variable *> get_vars_on_write(bool get_read_vars) const { return {}; }
 		virtual void bind_to_scope(AggregateScope &agg_scope) = 0;
-		virtual Uptr<ComputationNode> to_computation_tree() const = 0;
+		virtual ArenaUptr<ComputationNode> to_computation_tree(Arena &arena) const = 0;
 		virtual std::string to_string() const = 0;
 		virtual void accept(ExprVisitor &v) = 0;
 	};
@@ -53,12 +57,12 @@ namespace L3::program {
 	// instantiations must implement the virtual methods
 	template<typename Item>
 	class ItemRef : public Expr {
-		std::string free_name; // the name originally given to the variable
+		Symbol free_name; // the name originally given to the variable
 		Item *referent_nullable;
 
 		public:
 
-		ItemRef(std::string free_name) :
+		ItemRef(Symbol free_name) :
 			free_name { mv(free_name) },
 			referent_nullable { nullptr }
 		{}
@@ -81,10 +85,11 @@ namespace L3::program {
 			if (this->referent_nullable) {
 				return this->referent_nullable->get_name();
 			} else {
-				return this->free_name;
+				return this->free_name.str();
 			}
 		}
-		virtual Uptr<ComputationNode> to_computation_tree() const override;
+		Symbol get_free_name() const { return this->free_name; }
+		virtual ArenaUptr<ComputationNode> to_computation_tree(Arena &arena) const override;
 		virtual std::string to_string() const override;
 		virtual void accept(ExprVisitor &v) override { v.visit(*this); }
 	};
@@ -99,7 +104,7 @@ namespace L3::program {
 
 		int64_t get_value() const { return this->value; }
 		virtual void bind_to_scope(AggregateScope &agg_scope) override;
-		virtual Uptr<ComputationNode> to_computation_tree() const override;
+		virtual ArenaUptr<ComputationNode> to_computation_tree(Arena &arena) const override;
 		virtual std::string to_string() const override;
 		virtual void accept(ExprVisitor &v) override { v.visit(*this); }
 	};
@@ -116,7 +121,7 @@ namespace L3::program {
 		// virtual Set<Variable *> get_vars_on_read() const override;
 		// virtual Set<Variable *> get_vars_on_write(bool get_read_vars) const override;
 		virtual void bind_to_scope(AggregateScope &agg_scope) override;
-		virtual Uptr<ComputationNode> to_computation_tree() const override;
+		virtual ArenaUptr<ComputationNode> to_computation_tree(Arena &arena) const override;
 		virtual std::string to_string() const override;
 		virtual void accept(ExprVisitor &v) override { v.visit(*this); }
 	};
@@ -137,6 +142,8 @@ namespace L3::program {
 	Operator str_to_op(std::string_view str);
 	std::string to_string(Operator op);
 	Opt<Operator> flip_operator(Operator op);
+	bool is_arithmetic_operator(Operator op);
+	bool is_comparison_operator(Operator op);
 
 	class BinaryOperation : public Expr {
 		Uptr<Expr> lhs;
@@ -154,7 +161,7 @@ namespace L3::program {
 		// virtual Set<Variable *> get_vars_on_read() const override;
 		// virtual Set<Variable *> get_vars_on_write(bool get_read_vars) const override;
 		virtual void bind_to_scope(AggregateScope &agg_scope) override;
-		virtual Uptr<ComputationNode> to_computation_tree() const override;
+		virtual ArenaUptr<ComputationNode> to_computation_tree(Arena &arena) const override;
 		virtual std::string to_string() const override;
 		virtual void accept(ExprVisitor &v) override { v.visit(*this); }
 	};
@@ -172,7 +179,7 @@ namespace L3::program {
 		// virtual Set<Variable *> get_vars_on_read() const override;
 		// virtual Set<Variable *> get_vars_on_write(bool get_read_vars) const override;
 		virtual void bind_to_scope(AggregateScope &agg_scope) override;
-		virtual Uptr<ComputationNode> to_computation_tree() const override;
+		virtual ArenaUptr<ComputationNode> to_computation_tree(Arena &arena) const override;
 		virtual std::string to_string() const override;
 		virtual void accept(ExprVisitor &v) override { v.visit(*this); }
 	};
@@ -197,7 +204,7 @@ namespace L3::program {
 	class Instruction {
 		public:
 		virtual void bind_to_scope(AggregateScope &agg_scope) = 0;
-		virtual Uptr<ComputationNode> to_computation_tree() const = 0;
+		virtual ArenaUptr<ComputationNode> to_computation_tree(Arena &arena) const = 0;
 		virtual std::string to_string() const = 0;
 		virtual void accept(InstructionVisitor &v) = 0;
 
@@ -219,7 +226,7 @@ namespace L3::program {
 		InstructionReturn(Opt<Uptr<Expr>> &&return_value) : return_value { mv(return_value) } {}
 
 		virtual void bind_to_scope(AggregateScope &agg_scope) override;
-		virtual Uptr<ComputationNode> to_computation_tree() const override;
+		virtual ArenaUptr<ComputationNode> to_computation_tree(Arena &arena) const override;
 		virtual Instruction::ControlFlowResult get_control_flow() const { return { false, false, Opt<ItemRef<BasicBlock> *>() }; };
 		virtual std::string to_string() const override;
 		virtual void accept(InstructionVisitor &v) override { v.visit(*this); }
@@ -238,7 +245,7 @@ namespace L3::program {
 		{}
 
 		virtual void bind_to_scope(AggregateScope &agg_scope) override;
-		virtual Uptr<ComputationNode> to_computation_tree() const override;
+		virtual ArenaUptr<ComputationNode> to_computation_tree(Arena &arena) const override;
 		virtual Instruction::ControlFlowResult get_control_flow() const override;
 		virtual std::string to_string() const override;
 		virtual void accept(InstructionVisitor &v) override { v.visit(*this); }
@@ -255,22 +262,23 @@ namespace L3::program {
 		{}
 
 		virtual void bind_to_scope(AggregateScope &agg_scope) override;
-		virtual Uptr<ComputationNode> to_computation_tree() const override;
+		virtual ArenaUptr<ComputationNode> to_computation_tree(Arena &arena) const override;
 		virtual Instruction::ControlFlowResult get_control_flow() const override;
 		virtual std::string to_string() const override;
 		virtual void accept(InstructionVisitor &v) override { v.visit(*this); }
 	};
 
 	class InstructionLabel : public Instruction {
-		std::string label_name;
+		Symbol label_name;
 
 		public:
 
-		InstructionLabel(std::string label_name) : label_name { mv(label_name) } {}
+		InstructionLabel(Symbol label_name) : label_name { label_name } {}
 
-		const std::string &get_name() const { return this->label_name; }
+		const std::string &get_name() const { return this->label_name.str(); }
+		Symbol get_symbol() const { return this->label_name; }
 		virtual void bind_to_scope(AggregateScope &agg_scope) override;
-		virtual Uptr<ComputationNode> to_computation_tree() const override;
+		virtual ArenaUptr<ComputationNode> to_computation_tree(Arena &arena) const override;
 		virtual Instruction::ControlFlowResult get_control_flow() const { return { true, false, Opt<ItemRef<BasicBlock> *>()}; };
 		virtual std::string to_string() const override;
 		virtual void accept(InstructionVisitor &v) override { v.visit(*this); }
@@ -291,7 +299,7 @@ namespace L3::program {
 
 		virtual void bind_to_scope(AggregateScope &agg_scope) override;
 		virtual Instruction::ControlFlowResult get_control_flow() const override;
-		virtual Uptr<ComputationNode> to_computation_tree() const override;
+		virtual ArenaUptr<ComputationNode> to_computation_tree(Arena &arena) const override;
 		virtual std::string to_string() const override;
 		virtual void accept(InstructionVisitor &v) override { v.visit(*this); }
 	};
@@ -308,13 +316,14 @@ namespace L3::program {
 		ComputationNode(Opt<Variable *> destination) :
 			destination { destination }
 		{}
+		virtual ~ComputationNode() = default;
 		virtual std::string to_string() const;
 		virtual Set<Variable*> get_vars_read() const = 0;
 		virtual Opt<Variable*> get_var_written() const;
 
 		// Returns every instance of the specific variable found in the leaves
 		// of the tree
-		virtual Vec<Uptr<ComputationNode> *> get_merge_targets(Variable *target) = 0;
+		virtual Vec<ArenaUptr<ComputationNode> *> get_merge_targets(Variable *target) = 0;
 	};
 
 	struct NoOpCn : ComputationNode {
@@ -322,7 +331,7 @@ namespace L3::program {
 		NoOpCn() : ComputationNode({}) {}
 		virtual std::string to_string() const override;
 		virtual Set<Variable*> get_vars_read() const override;
-		virtual Vec<Uptr<ComputationNode> *> get_merge_targets(Variable *target) override;
+		virtual Vec<ArenaUptr<ComputationNode> *> get_merge_targets(Variable *target) override;
 	};
 
 	// represents an atomic "computation" that just returns the value of a variable
@@ -332,7 +341,7 @@ namespace L3::program {
 		NumberCn(int64_t value) : ComputationNode({}), value { value } {}
 		virtual std::string to_string() const override;
 		virtual Set<Variable *> get_vars_read() const override;
-		virtual Vec<Uptr<ComputationNode> *> get_merge_targets(Variable *target) override;
+		virtual Vec<ArenaUptr<ComputationNode> *> get_merge_targets(Variable *target) override;
 	};
 
 	// represents an atomic "computation" that just returns the value of a variable
@@ -341,7 +350,7 @@ namespace L3::program {
 		VariableCn(Variable *var) : ComputationNode(std::make_optional<Variable *>(var)) {}
 		virtual std::string to_string() const override;
 		virtual Set<Variable *> get_vars_read() const override;
-		virtual Vec<Uptr<ComputationNode> *> get_merge_targets(Variable *target) override;
+		virtual Vec<ArenaUptr<ComputationNode> *> get_merge_targets(Variable *target) override;
 	};
 
 	// represents an atomic "computation" that just returns a function pointer
@@ -351,7 +360,7 @@ namespace L3::program {
 		FunctionCn(Function *function) : ComputationNode({}), function { function } {}
 		virtual std::string to_string() const override;
 		virtual Set<Variable *> get_vars_read() const override;
-		virtual Vec<Uptr<ComputationNode> *> get_merge_targets(Variable *target) override;
+		virtual Vec<ArenaUptr<ComputationNode> *> get_merge_targets(Variable *target) override;
 	};
 
 	// represents an atomic "computation" that just returns a labeled location
@@ -361,95 +370,95 @@ namespace L3::program {
 		LabelCn(BasicBlock *jmp_dest) : ComputationNode({}), jmp_dest { jmp_dest } {}
 		virtual std::string to_string() const override;
 		virtual Set<Variable *> get_vars_read() const override;
-		virtual Vec<Uptr<ComputationNode> *> get_merge_targets(Variable *target) override;
+		virtual Vec<ArenaUptr<ComputationNode> *> get_merge_targets(Variable *target) override;
 	};
 
 	struct MoveCn : ComputationNode {
-		Uptr<ComputationNode> source;
+		ArenaUptr<ComputationNode> source;
 
-		MoveCn(Opt<Variable *> destination, Uptr<ComputationNode> source) :
+		MoveCn(Opt<Variable *> destination, ArenaUptr<ComputationNode> source) :
 			ComputationNode(destination), source { mv(source) }
 		{}
 		virtual std::string to_string() const override;
 		virtual Set<Variable *> get_vars_read() const override;
-		virtual Vec<Uptr<ComputationNode> *> get_merge_targets(Variable *target) override;
+		virtual Vec<ArenaUptr<ComputationNode> *> get_merge_targets(Variable *target) override;
 	};
 
 	struct BinaryCn : ComputationNode {
 		Operator op;
-		Uptr<ComputationNode> lhs;
-		Uptr<ComputationNode> rhs;
+		ArenaUptr<ComputationNode> lhs;
+		ArenaUptr<ComputationNode> rhs;
 
-		BinaryCn(Opt<Variable *> destination, Operator op, Uptr<ComputationNode> lhs, Uptr<ComputationNode> rhs) :
+		BinaryCn(Opt<Variable *> destination, Operator op, ArenaUptr<ComputationNode> lhs, ArenaUptr<ComputationNode> rhs) :
 			ComputationNode(destination), op {op}, lhs { mv(lhs) }, rhs { mv(rhs) }
 		{}
 		virtual std::string to_string() const override;
 		virtual Set<Variable *> get_vars_read() const override;
-		virtual Vec<Uptr<ComputationNode> *> get_merge_targets(Variable *target) override;
+		virtual Vec<ArenaUptr<ComputationNode> *> get_merge_targets(Variable *target) override;
 	};
 
 	struct CallCn : ComputationNode {
-		Uptr<ComputationNode> callee;
-		Vec<Uptr<ComputationNode>> arguments;
+		ArenaUptr<ComputationNode> callee;
+		Vec<ArenaUptr<ComputationNode>> arguments;
 
-		CallCn(Opt<Variable *> destination, Uptr<ComputationNode> callee, Vec<Uptr<ComputationNode>> arguments) :
+		CallCn(Opt<Variable *> destination, ArenaUptr<ComputationNode> callee, Vec<ArenaUptr<ComputationNode>> arguments) :
 			ComputationNode(destination), callee { mv(callee) }, arguments { mv(arguments) }
 		{}
 		virtual std::string to_string() const override;
 		virtual Set<Variable *> get_vars_read() const override;
-		virtual Vec<Uptr<ComputationNode> *> get_merge_targets(Variable *target) override;
+		virtual Vec<ArenaUptr<ComputationNode> *> get_merge_targets(Variable *target) override;
 
 	};
 
 	struct LoadCn : ComputationNode {
-		Uptr<ComputationNode> address;
+		ArenaUptr<ComputationNode> address;
 
-		LoadCn(Opt<Variable *> destination, Uptr<ComputationNode> address) :
+		LoadCn(Opt<Variable *> destination, ArenaUptr<ComputationNode> address) :
 			ComputationNode(destination), address { mv(address) }
 		{}
 		virtual std::string to_string() const override;
 		virtual Set<Variable *> get_vars_read() const override;
-		virtual Vec<Uptr<ComputationNode> *> get_merge_targets(Variable *target) override;
+		virtual Vec<ArenaUptr<ComputationNode> *> get_merge_targets(Variable *target) override;
 	};
 
 	struct StoreCn : ComputationNode {
-		Uptr<ComputationNode> address;
-		Uptr<ComputationNode> value;
+		ArenaUptr<ComputationNode> address;
+		ArenaUptr<ComputationNode> value;
 
 		// note that there is no destination argument
-		StoreCn(Uptr<ComputationNode> address, Uptr<ComputationNode> value) :
+		StoreCn(ArenaUptr<ComputationNode> address, ArenaUptr<ComputationNode> value) :
 			ComputationNode({}), address { mv(address) }, value { mv(value) }
 		{}
 		virtual std::string to_string() const override;
 		virtual Set<Variable *> get_vars_read() const override;
-		virtual Vec<Uptr<ComputationNode> *> get_merge_targets(Variable* target) override;
+		virtual Vec<ArenaUptr<ComputationNode> *> get_merge_targets(Variable* target) override;
 	};
 
 	struct BranchCn : ComputationNode {
 		BasicBlock *jmp_dest;
-		Opt<Uptr<ComputationNode>> condition;
+		Opt<ArenaUptr<ComputationNode>> condition;
 
 		// note that there is no destination argument
-		BranchCn(BasicBlock *jmp_dest, Opt<Uptr<ComputationNode>> condition) :
+		BranchCn(BasicBlock *jmp_dest, Opt<ArenaUptr<ComputationNode>> condition) :
 			ComputationNode({}), jmp_dest { jmp_dest }, condition { mv(condition) }
 		{}
 		virtual std::string to_string() const override;
 		virtual Set<Variable *> get_vars_read() const override;
-		virtual Vec<Uptr<ComputationNode> *> get_merge_targets(Variable *target) override;
+		virtual Vec<ArenaUptr<ComputationNode> *> get_merge_targets(Variable *target) override;
 	};
 
 	struct ReturnCn : ComputationNode {
-		Opt<Uptr<ComputationNode>> value;
+		Opt<ArenaUptr<ComputationNode>> value;
 
 		// note that there is no destination argument
 		ReturnCn() : ComputationNode({}), value {} {}
-		ReturnCn(Uptr<ComputationNode> value) : ComputationNode({}), value { mv(value) } {}
+		ReturnCn(ArenaUptr<ComputationNode> value) : ComputationNode({}), value { mv(value) } {}
 		virtual std::string to_string() const override;
 		virtual Set<Variable *> get_vars_read() const override;
-		virtual Vec<Uptr<ComputationNode> *> get_merge_targets(Variable *target) override;
+		virtual Vec<ArenaUptr<ComputationNode> *> get_merge_targets(Variable *target) override;
 	};
 
-	std::string to_string(const Uptr<ComputationNode> &node);
+	std::string to_string(const ArenaUptr<ComputationNode> &node);
 	std::string to_string(const ComputationNode &node);
 
 	template<typename... CnSubclasses>
@@ -460,18 +469,23 @@ namespace L3::program {
 	// meant to hold a computation tree as well as all the information that comes
 	// along with it: variables read and variables written, as well as all
 	// possible merge candidates
+	// The nodes of the tree are allocated in the arena passed to the
+	// constructor, which must outlive the box.
 	class ComputationTreeBox {
-		Uptr<ComputationNode> root_nullable; // null means this box has been stolen from in a merge
+		ArenaUptr<ComputationNode> root_nullable; // null means this box has been stolen from in a merge
 		bool has_load;
 		bool has_store;
 
 		public:
 
-		ComputationTreeBox(const Instruction &inst);
+		ComputationTreeBox(const Instruction &inst, Arena &arena);
+		// for trees made by the passes rather than from an instruction
+		explicit ComputationTreeBox(ArenaUptr<ComputationNode> root);
 		// it is the reponsibility of the caller to make sure this box has a
 		// value before doing any other operation
 		const bool has_value() const { return static_cast<bool>(this->root_nullable); }
-		const Uptr<ComputationNode> &get_tree() const { return this->root_nullable; }
+		const ArenaUptr<ComputationNode> &get_tree() const { return this->root_nullable; }
+		ArenaUptr<ComputationNode> &get_tree() { return this->root_nullable; }
 		Set<Variable *> get_variables_read() const { return this->root_nullable->get_vars_read(); }
 		const bool get_has_load() const { return this->has_load; }
 		const bool get_has_store() const { return this->has_store; }
@@ -483,17 +497,70 @@ namespace L3::program {
 		bool merge(ComputationTreeBox &other);
 	};
 
+	// A set of the variables of a single L3Function, stored as a bitset
+	// indexed by Variable::get_index() so that the set operations of the
+	// liveness analysis are simple loops over machine words. Iterating over
+	// the set yields the Variable pointers in index order.
+	class VarSet {
+		using Word = uint64_t;
+		static const int WORD_BITS = 64;
+
+		const Vec<Uptr<Variable>> *variables_nullable; // the function's variables, indexable by Variable::get_index()
+		Vec<Word> words;
+
+		public:
+
+		class Iterator {
+			const VarSet *set;
+			size_t word_index;
+			Word remaining_bits; // the bits of the current word not yet iterated over
+
+			public:
+
+			Iterator(const VarSet *set, size_t word_index);
+			Variable *operator*() const;
+			Iterator &operator++();
+			bool operator==(const Iterator &other) const {
+				return this->word_index == other.word_index && this->remaining_bits == other.remaining_bits;
+			}
+			bool operator!=(const Iterator &other) const { return !(*this == other); }
+
+			private:
+
+			void skip_empty_words();
+		};
+
+		VarSet() : variables_nullable { nullptr } {}
+		explicit VarSet(const Vec<Uptr<Variable>> &variables) :
+			variables_nullable { &variables },
+			words((variables.size() + WORD_BITS - 1) / WORD_BITS, 0)
+		{}
+
+		void insert(const Variable *var);
+		void erase(const Variable *var);
+		bool contains(const Variable *var) const;
+		bool empty() const;
+		void clear();
+		VarSet &operator|=(const VarSet &other); // union
+		VarSet &operator-=(const VarSet &other); // difference
+		bool operator==(const VarSet &other) const;
+		bool operator!=(const VarSet &other) const { return !(*this == other); }
+		Iterator begin() const { return Iterator(this, 0); }
+		Iterator end() const { return Iterator(this, this->words.size()); }
+	};
+
 	class BasicBlock {
 		std::string name; // the empty string is treated as a lack of name; we can't just have an optional because ItemRef<BasicBlock> demans that the get_name method always returns a string
 		Vec<Uptr<Instruction>> raw_instructions;
 		Vec<ComputationTreeBox> tree_boxes;
 		struct VarLiveness {
-			Set<Variable *> gen_set;
-			Set<Variable *> kill_set;
-			Set<Variable *> in_set;
-			Set<Variable *> out_set;
+			VarSet gen_set;
+			VarSet kill_set;
+			VarSet in_set;
+			VarSet out_set;
 		} var_liveness;
 		Vec<BasicBlock *> succ_blocks;
+		Vec<BasicBlock *> pred_blocks;
 
 		explicit BasicBlock();
 
@@ -513,10 +580,33 @@ namespace L3::program {
 		void mangle_name(std::string new_name) { this->name = mv(new_name); }
 		Vec<Uptr<Instruction>> &get_raw_instructions() { return this->raw_instructions; }
 		const Vec<Uptr<Instruction>> &get_raw_instructions() const { return this->raw_instructions; }
+		Vec<ComputationTreeBox> &get_tree_boxes() { return this->tree_boxes; }
 		const Vec<ComputationTreeBox> &get_tree_boxes() const { return this->tree_boxes; }
+		const VarSet &get_in_set() const { return this->var_liveness.in_set; }
+		const VarSet &get_out_set() const { return this->var_liveness.out_set; }
 		const Vec<BasicBlock *> &get_succ_blocks() const { return this->succ_blocks; }
-		void generate_computation_trees(); // also generates the gen and kill sets
-		bool update_in_out_sets();
+		const Vec<BasicBlock *> &get_pred_blocks() const { return this->pred_blocks; }
+		void generate_computation_trees(Arena &arena);
+		void generate_gen_kill_sets(const Vec<Uptr<Variable>> &function_vars); // also resets the in and out sets
+		void clear_computation_trees() { this->tree_boxes.clear(); }
+		// whether control can go from the end of the block's trees to the
+		// block laid out after it
+		bool falls_through() const;
+		bool update_in_out_sets(); // returns whether the in set changed
+
+		// Fills in the predecessors of every block from the successors of
+		// every block. All the blocks of the function must be passed in.
+		static void generate_pred_blocks(const Vec<Uptr<BasicBlock>> &blocks);
+		// Fills in the successors of every block from its last tree and from
+		// the order of the blocks, for after the passes have moved trees or
+		// blocks around. All the blocks of the function must be passed in,
+		// in the order they are laid out.
+		static void generate_succ_blocks(const Vec<Uptr<BasicBlock>> &blocks);
+		// Makes the edges from this block to `old_succ` go to `new_succ`
+		// instead, retargeting the block's branch tree if it jumps there.
+		// The caller must make sure the fallthrough successor (if any) is
+		// still the next block, and regenerate the pred blocks afterwards.
+		void replace_succ_block(BasicBlock *old_succ, BasicBlock *new_succ);
 		void merge_trees();
 		std::string to_string() const;
 
@@ -541,7 +631,7 @@ namespace L3::program {
 			// being built. This only exists because we need a memory location
 			// so that BasicBlocks can be linked to each other.
 			// THIS POINTER SHOULD NOT BE READ!
-			Pair<BasicBlock *, Opt<std::string>> get_fetus_and_name();
+			Pair<BasicBlock *, Opt<Symbol>> get_fetus_and_name();
 
 			// Takes an Instruction that has all its free names either bound
 			// or pending binding to a scope.
@@ -565,8 +655,8 @@ namespace L3::program {
 		// If a Scope has a parent, then it cannot have any
 		// free_refs; they must have been transferred to the parent.
 		Opt<Scope *> parent;
-		Map<std::string, Item *> dict;
-		Map<std::string, Vec<ItemRef<Item> *>> free_refs;
+		Map<Symbol, Item *> dict;
+		Map<Symbol, Vec<ItemRef<Item> *>> free_refs;
 
 		public:
 
@@ -596,7 +686,7 @@ namespace L3::program {
 
 		// returns whether the ref was immediately bound or was left as free
 		bool add_ref(ItemRef<Item> &item_ref) {
-			std::string_view ref_name = item_ref.get_ref_name();
+			Symbol ref_name = item_ref.get_free_name();
 
 			Opt<Item *> maybe_item = this->get_item_maybe(ref_name);
 			if (maybe_item) {
@@ -613,10 +703,10 @@ namespace L3::program {
 		// Adds the specified item to this scope under the specified name,
 		// resolving all free refs who were depending on that name. Dies if
 		// there already exists an item under that name.
-		void resolve_item(std::string name, Item *item) {
+		void resolve_item(Symbol name, Item *item) {
 			auto existing_item_it = this->dict.find(name);
 			if (existing_item_it != this->dict.end()) {
-				std::cerr << "name conflict: " << name << std::endl;
+				std::cerr << "name conflict: " << name.str() << std::endl;
 				exit(-1);
 			}
 
@@ -650,7 +740,7 @@ namespace L3::program {
 			}
 		} */
 
-		std::optional<Item *> get_item_maybe(std::string_view name) {
+		std::optional<Item *> get_item_maybe(Symbol name) {
 			auto item_it = this->dict.find(name);
 			if (item_it != this->dict.end()) {
 				return std::make_optional<Item *>(item_it->second);
@@ -704,8 +794,8 @@ namespace L3::program {
 		}
 
 		// returns the free names exist in this scope
-		Vec<std::string> get_free_names() const {
-			Vec<std::string> result;
+		Vec<Symbol> get_free_names() const {
+			Vec<Symbol> result;
 			for (auto &[name, free_refs_vec] : this->free_refs) {
 				result.push_back(name);
 			}
@@ -730,11 +820,10 @@ namespace L3::program {
 		// be caught by the parent Scope and resolved, or the parent might
 		// also expose it as a free ref recursively.
 		void push_free_ref(ItemRef<Item> &item_ref) {
-			std::string_view ref_name = item_ref.get_ref_name();
 			if (this->parent) {
 				(*this->parent)->add_ref(item_ref);
 			} else {
-				this->free_refs[std::string(ref_name)].push_back(&item_ref);
+				this->free_refs[item_ref.get_free_name()].push_back(&item_ref);
 			}
 		}
 	};
@@ -752,32 +841,51 @@ namespace L3::program {
 	};
 
 	class Variable {
-		std::string name;
+		Symbol name;
+		int index; // unique and dense among the variables of its function
 
 		public:
 
-		Variable(std::string name) : name { mv(name) } {}
+		Variable(Symbol name, int index) : name { name }, index { index } {}
 
-		const std::string &get_name() const { return this->name; }
+		const std::string &get_name() const { return this->name.str(); }
+		int get_index() const { return this->index; }
 		std::string to_string() const;
 	};
 
 	std::string to_string(Variable *const &variable);
 
+	// What a call to a function can do besides computing its result, so
+	// that the passes know which memory a call might change and where
+	// control can't come back from.
+	struct FunctionEffects {
+		bool reads_memory;
+		bool writes_memory; // to memory that existed before the call
+		bool allocates; // returns memory that nothing else refers to yet
+		bool never_returns;
+
+		// for a callee that isn't known
+		static FunctionEffects unknown() { return { true, true, true, false }; }
+	};
+
 	// interface
 	class Function {
 		public:
 		virtual const std::string &get_name() const = 0;
 		virtual bool verify_argument_num(int num) const = 0;
-		// virtual bool get_never_returns() const = 0;
+		// whether a call to the function can never come back to the caller
+		virtual bool get_never_returns() const = 0;
 		virtual std::string to_string() const = 0;
 	};
 
 	class L3Function : public Function {
 		std::string name;
+		Arena node_arena; // holds the computation trees of the blocks; declared before them so that it is destroyed after them
 		Vec<Uptr<BasicBlock>> blocks;
+		Vec<Uptr<BasicBlock>> removed_blocks; // see remove_block
 		Vec<Uptr<Variable>> vars;
 		Vec<Variable *> parameter_vars;
+		bool never_returns;
 
 		explicit L3Function(
 			std::string name,
@@ -788,7 +896,8 @@ namespace L3::program {
 			name { mv(name) },
 			blocks { mv(blocks) },
 			vars { mv(vars) },
-			parameter_vars { mv(parameter_vars) }
+			parameter_vars { mv(parameter_vars) },
+			never_returns { false }
 		{}
 
 		public:
@@ -797,8 +906,23 @@ namespace L3::program {
 		Vec<Uptr<BasicBlock>> &get_blocks() { return this->blocks; }
 		const Vec<Uptr<BasicBlock>> &get_blocks() const { return this->blocks; }
 		const Vec<Variable *> &get_parameter_vars() const { return this->parameter_vars; }
+		const Vec<Uptr<Variable>> &get_vars() const { return this->vars; }
+		Arena &get_node_arena() { return this->node_arena; }
+		// Makes a new variable for the passes to use. The name must not be
+		// one that an L3 variable could have.
+		Variable *add_variable(std::string_view name);
+		// Takes a block that a pass has moved out of the layout. It is kept
+		// alive until the function is destroyed, since the inline candidates
+		// may still be copying its instructions into another function.
+		void remove_block(Uptr<BasicBlock> block) { this->removed_blocks.push_back(mv(block)); }
+		// Destroys the computation trees of every block and frees the memory
+		// they were allocated in. Call once the code of this function has
+		// been generated.
+		void release_computation_trees();
 		virtual bool verify_argument_num(int num) const override;
-		// virtual bool get_never_returns() const override;
+		// false until analyze::find_never_returning_functions says otherwise
+		virtual bool get_never_returns() const override { return this->never_returns; }
+		void set_never_returns(bool never_returns) { this->never_returns = never_returns; }
 		virtual std::string to_string() const override;
 
 		class Builder {
@@ -814,23 +938,25 @@ namespace L3::program {
 			Pair<Uptr<L3Function>, AggregateScope> get_result();
 			void add_name(std::string name);
 			void add_next_instruction(Uptr<Instruction> &&inst);
-			void add_parameter(std::string var_name);
+			void add_parameter(Symbol var_name);
 		};
 	};
 
 	class ExternalFunction : public Function {
 		std::string name;
 		Vec<int> valid_num_arguments;
+		FunctionEffects effects;
 
 		public:
 
-		ExternalFunction(std::string name, Vec<int> valid_num_arguments) :
-			name { mv(name) }, valid_num_arguments { mv(valid_num_arguments) }
+		ExternalFunction(std::string name, Vec<int> valid_num_arguments, FunctionEffects effects) :
+			name { mv(name) }, valid_num_arguments { mv(valid_num_arguments) }, effects { effects }
 		{}
 
 		virtual const std::string &get_name() const override { return this->name; }
+		const FunctionEffects &get_effects() const { return this->effects; }
 		virtual bool verify_argument_num(int num) const override;
-		// virtual bool get_never_returns() const override;
+		virtual bool get_never_returns() const override { return this->effects.never_returns; }
 		virtual std::string to_string() const override;
 	};
 
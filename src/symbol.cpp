@@ -0,0 +1,24 @@
+#include "symbol.h"
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+
+namespace L3::program {
+	Symbol Symbol::intern(std::string_view text) {
+		// the deque never moves its elements, so the keys of `entries` can
+		// point into it
+		static std::deque<Entry> storage;
+		static std::unordered_map<std::string_view, const Entry *> entries;
+		static std::mutex mutex;
+
+		std::lock_guard<std::mutex> lock(mutex);
+		auto it = entries.find(text);
+		if (it != entries.end()) {
+			return Symbol(it->second);
+		}
+		storage.push_back(Entry { std::string(text), static_cast<uint32_t>(storage.size()) });
+		const Entry *entry = &storage.back();
+		entries.emplace(entry->text, entry);
+		return Symbol(entry);
+	}
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "std_alias.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace L3::program {
+	using namespace std_alias;
+
+	// A handle to an identifier interned in the symbol table, which lives as
+	// long as the process does. Every occurrence of the same identifier gets
+	// the same handle, so ItemRefs and Scopes can hold and compare Symbols
+	// instead of owning copies of the name.
+	// Symbols are ordered by when they were first interned, which keeps the
+	// iteration order of maps keyed by them deterministic.
+	class Symbol {
+		struct Entry {
+			std::string text;
+			uint32_t id;
+		};
+
+		const Entry *entry;
+
+		explicit Symbol(const Entry *entry) : entry { entry } {}
+
+		public:
+
+		// Returns the Symbol for the given text, adding it to the symbol
+		// table if it isn't there yet. Safe to call from multiple threads.
+		static Symbol intern(std::string_view text);
+
+		const std::string &str() const { return this->entry->text; }
+
+		bool operator==(const Symbol &other) const { return this->entry == other.entry; }
+		bool operator!=(const Symbol &other) const { return this->entry != other.entry; }
+		bool operator<(const Symbol &other) const { return this->entry->id < other.entry->id; }
+	};
+}
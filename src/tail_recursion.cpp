@@ -0,0 +1,129 @@
+#include "tail_recursion.h"
+#include "target_arch.h"
+#include "std_alias.h"
+#include <algorithm>
+
+namespace L3::program::analyze {
+	using namespace std_alias;
+
+	// Whether the function returns as soon as the tree at `tree_index` in
+	// the block at `block_index` is done, with the value of `result` if it
+	// returns one at all.
+	bool returns_right_after(
+		const Vec<Uptr<BasicBlock>> &blocks,
+		size_t block_index,
+		size_t tree_index,
+		Opt<Variable *> result
+	) {
+		// everything up to the return must be a no-op (like a label); if a
+		// block runs out first, it falls through into the next one
+		tree_index += 1;
+		for (; block_index < blocks.size(); ++block_index, tree_index = 0) {
+			const Vec<ComputationTreeBox> &tree_boxes = blocks[block_index]->get_tree_boxes();
+			for (; tree_index < tree_boxes.size(); ++tree_index) {
+				const ComputationNode &tree = *tree_boxes[tree_index].get_tree();
+				if (is_dynamic_type<NoOpCn>(tree)) {
+					continue;
+				}
+				const ReturnCn *return_node = dynamic_cast<const ReturnCn *>(&tree);
+				if (!return_node) {
+					return false;
+				}
+				if (!return_node->value) {
+					return true;
+				}
+				const VariableCn *var_node = dynamic_cast<const VariableCn *>(return_node->value->get());
+				return var_node && result && var_node->destination == result;
+			}
+		}
+		return false;
+	}
+
+	int eliminate_tail_recursion(L3Function &l3_function) {
+		Vec<Uptr<BasicBlock>> &blocks = l3_function.get_blocks();
+		Arena &arena = l3_function.get_node_arena();
+		const Vec<Variable *> &parameter_vars = l3_function.get_parameter_vars();
+		Map<Variable *, Variable *> parameter_temps;
+		int num_replaced = 0;
+		for (size_t i = 0; i < blocks.size(); ++i) {
+			Vec<ComputationTreeBox> &tree_boxes = blocks[i]->get_tree_boxes();
+			for (size_t j = 0; j < tree_boxes.size(); ++j) {
+				const CallCn *call_node = dynamic_cast<const CallCn *>(tree_boxes[j].get_tree().get());
+				if (!call_node) {
+					continue;
+				}
+				const FunctionCn *callee_node = dynamic_cast<const FunctionCn *>(call_node->callee.get());
+				if (!callee_node
+					|| callee_node->function != &l3_function
+					|| call_node->arguments.size() != parameter_vars.size()
+					|| !returns_right_after(blocks, i, j, call_node->destination))
+				{
+					continue;
+				}
+
+				// The parameters are all assigned at once, so an argument
+				// that reads a parameter other than the one it's assigned to
+				// goes through a temporary first. The names of the
+				// temporaries start with a digit, which an L3 variable's name
+				// can't.
+				ArenaUptr<ComputationNode> call_tree = mv(tree_boxes[j].get_tree());
+				CallCn &call = static_cast<CallCn &>(*call_tree);
+				Vec<ComputationTreeBox> new_tree_boxes;
+				Vec<ArenaUptr<ComputationNode>> sources;
+				for (size_t k = 0; k < parameter_vars.size(); ++k) {
+					ArenaUptr<ComputationNode> &argument = call.arguments[k];
+					const VariableCn *var_node = dynamic_cast<const VariableCn *>(argument.get());
+					if (var_node && *var_node->destination == parameter_vars[k]) {
+						sources.emplace_back(); // already in place
+						continue;
+					}
+					bool reads_other_parameter = var_node && std::find(
+						parameter_vars.begin(),
+						parameter_vars.end(),
+						*var_node->destination
+					) != parameter_vars.end();
+					if (reads_other_parameter) {
+						auto [it, inserted] = parameter_temps.insert({ parameter_vars[k], nullptr });
+						if (inserted) {
+							it->second = l3_function.add_variable("0tail_" + parameter_vars[k]->get_name());
+						}
+						new_tree_boxes.emplace_back(arena.make<MoveCn>(it->second, mv(argument)));
+						sources.push_back(arena.make<VariableCn>(it->second));
+					} else {
+						sources.push_back(mv(argument));
+					}
+				}
+				for (size_t k = 0; k < parameter_vars.size(); ++k) {
+					if (sources[k]) {
+						new_tree_boxes.emplace_back(arena.make<MoveCn>(parameter_vars[k], mv(sources[k])));
+					}
+				}
+
+				// The jump goes to the entry block's label, which comes after
+				// the parameters are loaded from the argument registers.
+				BasicBlock *entry_block = blocks.front().get();
+				if (entry_block->get_name().size() == 0) {
+					entry_block->mangle_name(code_gen::target_arch::make_generated_label_name("entry", l3_function.get_name()));
+				}
+				new_tree_boxes.emplace_back(arena.make<BranchCn>(entry_block, Opt<ArenaUptr<ComputationNode>>()));
+
+				// the trees after the call are no-ops until the return, which
+				// is never reached from here anymore
+				tree_boxes.erase(tree_boxes.begin() + j, tree_boxes.end());
+				tree_boxes.insert(
+					tree_boxes.end(),
+					std::make_move_iterator(new_tree_boxes.begin()),
+					std::make_move_iterator(new_tree_boxes.end())
+				);
+				num_replaced += 1;
+				break;
+			}
+		}
+
+		if (num_replaced > 0) {
+			BasicBlock::generate_succ_blocks(blocks);
+			BasicBlock::generate_pred_blocks(blocks);
+		}
+		return num_replaced;
+	}
+}
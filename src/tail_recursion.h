@@ -0,0 +1,15 @@
+#pragma once
+#include "program.h"
+
+namespace L3::program::analyze {
+	// Assumes that the computation trees of the function have been generated
+	// and haven't been merged yet.
+	// Turns each call of the function to itself whose result is returned
+	// right away into assignments of the arguments to the parameters and a
+	// jump back to the entry block, so the recursion becomes a loop. Calls
+	// to other functions are left alone, since L2 can only enter a function
+	// through a `call` that comes back to the caller.
+	// The data flow must be generated afterwards. Returns the number of
+	// calls replaced.
+	int eliminate_tail_recursion(L3Function &l3_function);
+}
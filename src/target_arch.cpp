@@ -2,47 +2,47 @@
 #include <assert.h>
 
 namespace L3::code_gen::target_arch {
-	static const std::string register_args[] = {
-		"rdi", "rsi", "rdx", "rcx", "r8", "r9"
+	using l2::Instruction;
+	using l2::Operand;
+	using l2::Register;
+
+	static const Register register_args[] = {
+		Register::rdi, Register::rsi, Register::rdx, Register::rcx, Register::r8, Register::r9
 	};
 
-	std::string get_argument_loading_instruction(const std::string &l2_syntax, int argument_index, int num_args) {
+	Instruction get_argument_loading_instruction(Operand dest, int argument_index, int num_args) {
 		assert(argument_index >= 0 && num_args > argument_index);
 		if (argument_index < NUM_ARG_REGISTERS) {
-			return l2_syntax + " <- " + register_args[argument_index];
+			return Instruction::make_assign(dest, Operand::make_register(register_args[argument_index]));
 		}
 
 		int64_t rsp_offset = WORD_SIZE * (num_args - argument_index - 1);
-		return l2_syntax + " <- stack-arg " + std::to_string(rsp_offset);
+		return Instruction::make_stack_arg(dest, rsp_offset);
 	}
 
-	std::string get_argument_prepping_instruction(const std::string &l2_syntax, int argument_index) {
+	Instruction get_argument_prepping_instruction(Operand source, int argument_index) {
 		assert(argument_index >= 0);
 		if (argument_index < NUM_ARG_REGISTERS) {
-			return register_args[argument_index] + " <- " + l2_syntax;
+			return Instruction::make_assign(Operand::make_register(register_args[argument_index]), source);
 		}
 
 		int64_t rsp_offset = -WORD_SIZE * (argument_index - NUM_ARG_REGISTERS + 2); // 2 because simply offsetting by 1 would collide with return address
-		return "mem rsp " + std::to_string(rsp_offset) + " <- " + l2_syntax;
+		return Instruction::make_store(Operand::make_register(Register::rsp), rsp_offset, source);
 	}
 
-	std::string to_l2_expr(const Variable *var){
-		return "%_" + var->get_name();
+	Operand to_l2_expr(const Variable *var){
+		return Operand::make_variable(var);
 	}
-	std::string to_l2_expr(const BasicBlock *block){
-		return ":" + block->get_name();
+	Operand to_l2_expr(const BasicBlock *block){
+		return Operand::make_label(block);
 	}
-	std::string to_l2_expr(const Function *function){
-		if (dynamic_cast<const L3Function *>(function)) {
-			return "@" + function->get_name();
-		} else {
-			return function->get_name();
-		}
+	Operand to_l2_expr(const Function *function){
+		return Operand::make_function(function);
 	}
-	std::string to_l2_expr(int64_t number){
-		return std::to_string(number);
+	Operand to_l2_expr(int64_t number){
+		return Operand::make_number(number);
 	}
-	std::string to_l2_expr(const ComputationNode &node, bool ignore_dest) {
+	Operand to_l2_expr(const ComputationNode &node, bool ignore_dest) {
 		if (!ignore_dest && node.destination.has_value()) {
 			return to_l2_expr(*node.destination);
 		} else if (const LabelCn *label_node = dynamic_cast<const LabelCn *>(&node)) {
@@ -67,4 +67,17 @@ namespace L3::code_gen::target_arch {
 			}
 		}
 	}
+
+	std::string make_generated_label_name(std::string_view kind, std::string_view function_name, std::string_view suffix) {
+		assert(!kind.empty() && kind.front() != '_');
+		std::string name;
+		name.reserve(kind.size() + function_name.size() + 1 + suffix.size());
+		name += kind;
+		name += function_name;
+		if (!suffix.empty()) {
+			name += '_';
+			name += suffix;
+		}
+		return name;
+	}
 }
\ No newline at end of file
@@ -2,7 +2,9 @@
 
 #include "std_alias.h"
 #include "program.h"
+#include "l2.h"
 #include <string>
+#include <string_view>
 
 namespace L3::code_gen::target_arch {
 	using namespace std_alias;
@@ -12,17 +14,25 @@ namespace L3::code_gen::target_arch {
 	const int64_t WORD_SIZE = 8; // in bytes
 
 	// follows the L2 calling convention
-	std::string get_argument_loading_instruction(const std::string &arg_name, int argument_index, int num_args); // TODO fix to take the pre-generated l2 syntax instead of the arg name
-	std::string get_argument_prepping_instruction(const std::string &arg_name, int argument_index);
+	l2::Instruction get_argument_loading_instruction(l2::Operand dest, int argument_index, int num_args);
+	l2::Instruction get_argument_prepping_instruction(l2::Operand source, int argument_index);
 
-	std::string to_l2_expr(const Variable *var);
-	std::string to_l2_expr(const BasicBlock *block);
-	std::string to_l2_expr(const Function *function);
-	std::string to_l2_expr(int64_t number);
-	std::string to_l2_expr(const ComputationNode &node, bool ignore_dest = false);
+	l2::Operand to_l2_expr(const Variable *var);
+	l2::Operand to_l2_expr(const BasicBlock *block);
+	l2::Operand to_l2_expr(const Function *function);
+	l2::Operand to_l2_expr(int64_t number);
+	l2::Operand to_l2_expr(const ComputationNode &node, bool ignore_dest = false);
 
 	// Modifies a program so that its label names are all globally unique
 	// and always start with an underscore (so that non-underscore names can
 	// be used by the generator)
 	void mangle_label_names(Program &program);
+
+	// Makes the name of a label that the compiler adds rather than one from
+	// the source. `kind` says what the label is for and must not start with
+	// an underscore, which keeps the name apart from the mangled ones, and
+	// the function's name keeps it apart from the labels of other functions.
+	// The caller must keep `suffix` unique among the labels of that kind in
+	// the function.
+	std::string make_generated_label_name(std::string_view kind, std::string_view function_name, std::string_view suffix = "");
 }
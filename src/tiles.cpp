@@ -4,6 +4,8 @@
 #include "utils.h"
 #include <iostream>
 #include <algorithm>
+#include <typeinfo>
+#include <array>
 
 namespace L3::code_gen::tiles {
 	// TODO add more tiles for CISC instructions
@@ -23,33 +25,55 @@ namespace L3::code_gen::tiles {
 	}
 	*/
 
-	struct MatchFailError {};
-	// the following are functions throwing MatchFailError used for matching
-	// purposes
-	template<typename NodeType>
-	const NodeType &unwrap_node_type(const ComputationNode &node) {
-		const NodeType *downcasted = dynamic_cast<const NodeType *>(&node);
-		if (downcasted) {
-			return *downcasted;
-		} else {
-			throw MatchFailError {};
-		}
-	}
-	template<typename T>
-	const T &unwrap_optional(const Opt<T> &opt) {
-		if (opt) {
-			return *opt;
-		} else {
-			throw MatchFailError {};
-		}
+	// The kind of a computation node, used to index the tile patterns by the
+	// kind of node their root can match so that a tree is only ever matched
+	// against patterns that have a chance of succeeding.
+	enum struct NodeKind {
+		no_op,
+		number,
+		variable,
+		function,
+		label,
+		move,
+		binary,
+		call,
+		load,
+		store,
+		branch,
+		return_,
+		num_kinds // not a kind; the number of kinds
+	};
+	const int NUM_NODE_KINDS = static_cast<int>(NodeKind::num_kinds);
+
+	// a set of NodeKinds, one bit per kind
+	using NodeKindSet = uint32_t;
+	constexpr NodeKindSet kind_set(NodeKind kind) {
+		return NodeKindSet(1) << static_cast<int>(kind);
 	}
-	void throw_unless(bool success) {
-		if (!success) {
-			throw MatchFailError {};
-		}
+	template<typename... Kinds>
+	constexpr NodeKindSet kind_set(NodeKind kind, Kinds... kinds) {
+		return kind_set(kind) | kind_set(kinds...);
 	}
-	void fail_match() {
-		throw MatchFailError {};
+	const NodeKindSet ALL_NODE_KINDS = (NodeKindSet(1) << NUM_NODE_KINDS) - 1;
+
+	NodeKind get_node_kind(const ComputationNode &node) {
+		// every computation node type is a leaf in the class hierarchy, so
+		// comparing the exact types is enough
+		const std::type_info &type = typeid(node);
+		if (type == typeid(BinaryCn)) return NodeKind::binary;
+		if (type == typeid(VariableCn)) return NodeKind::variable;
+		if (type == typeid(NumberCn)) return NodeKind::number;
+		if (type == typeid(MoveCn)) return NodeKind::move;
+		if (type == typeid(LoadCn)) return NodeKind::load;
+		if (type == typeid(StoreCn)) return NodeKind::store;
+		if (type == typeid(CallCn)) return NodeKind::call;
+		if (type == typeid(BranchCn)) return NodeKind::branch;
+		if (type == typeid(ReturnCn)) return NodeKind::return_;
+		if (type == typeid(FunctionCn)) return NodeKind::function;
+		if (type == typeid(LabelCn)) return NodeKind::label;
+		if (type == typeid(NoOpCn)) return NodeKind::no_op;
+		std::cerr << "Error: unknown kind of computation node " << node.to_string() << "\n";
+		exit(1);
 	}
 
 	// "CTR" stands for "computation tree rule", and is kind of like a pegtl
@@ -67,19 +91,32 @@ namespace L3::code_gen::tiles {
 		// "Captures" describes the elements of the resulting struct that are
 		// taken from the target. this does not include any children CTRs that
 		// are passed in the template parameters.
+		// Every CTR has a static `match` method which returns an empty
+		// optional if the target does not match, and a static `root_kinds`
+		// member with the set of node kinds that the rule can possibly match.
 
 		// Matches: a NoOpCn or an atomic computation node that doens't do anything
 		// i.e. has no destination or is a VariableCn
 		struct NoOpCtr {
-			static NoOpCtr match(const ComputationNode &target) {
-				throw_unless(
+			static const NodeKindSet root_kinds = kind_set(
+				NodeKind::no_op,
+				NodeKind::variable,
+				NodeKind::function,
+				NodeKind::number,
+				NodeKind::label
+			);
+
+			static Opt<NoOpCtr> match(const ComputationNode &target) {
+				if (!(
 					is_dynamic_type<NoOpCn, VariableCn>(target)
 					|| (
 						is_dynamic_type<FunctionCn, NumberCn, LabelCn>(target)
 						&& !target.destination.has_value()
 					)
-				);
-				return {};
+				)) {
+					return {};
+				}
+				return NoOpCtr {};
 			}
 		};
 
@@ -91,13 +128,15 @@ namespace L3::code_gen::tiles {
 		struct AnyCtr {
 			const ComputationNode *node;
 
-			static AnyCtr match(const ComputationNode &target) {
-				return { &target };
+			static const NodeKindSet root_kinds = ALL_NODE_KINDS;
+
+			static Opt<AnyCtr> match(const ComputationNode &target) {
+				return AnyCtr { &target };
 			}
 		};
 
 		// TODO inexplicableS and inexplicableT should probably return their own
-		// variants so that it doesn't seem like Uptr<ComputationNode> is a
+		// variants so that it doesn't seem like ArenaUptr<ComputationNode> is a
 		// possibility
 
 		// Matches: A computation node that can be expressed as an "T"
@@ -106,9 +145,13 @@ namespace L3::code_gen::tiles {
 		struct InexplicableTCtr {
 			const ComputationNode *node;
 
-			static InexplicableTCtr match(const ComputationNode &target) {
-				throw_unless(target.destination.has_value() || is_dynamic_type<NumberCn>(target));
-				return { &target };
+			static const NodeKindSet root_kinds = ALL_NODE_KINDS; // anything can have a destination
+
+			static Opt<InexplicableTCtr> match(const ComputationNode &target) {
+				if (!(target.destination.has_value() || is_dynamic_type<NumberCn>(target))) {
+					return {};
+				}
+				return InexplicableTCtr { &target };
 			}
 		};
 
@@ -118,10 +161,15 @@ namespace L3::code_gen::tiles {
 		struct InexplicableSCtr {
 			const ComputationNode *node;
 
-			static InexplicableSCtr match(const ComputationNode &target) {
-				throw_unless(target.destination.has_value()
-					|| is_dynamic_type<NumberCn, LabelCn, FunctionCn>(target));
-				return { &target };
+			static const NodeKindSet root_kinds = ALL_NODE_KINDS; // anything can have a destination
+
+			static Opt<InexplicableSCtr> match(const ComputationNode &target) {
+				if (!(target.destination.has_value()
+					|| is_dynamic_type<NumberCn, LabelCn, FunctionCn>(target)))
+				{
+					return {};
+				}
+				return InexplicableSCtr { &target };
 			}
 		};
 
@@ -132,9 +180,13 @@ namespace L3::code_gen::tiles {
 		struct ConstantCtr {
 			const ComputationNode *node;
 
-			static ConstantCtr match(const ComputationNode &target) {
-				throw_unless(is_dynamic_type<NumberCn, LabelCn, FunctionCn>(target));
-				return { &target };
+			static const NodeKindSet root_kinds = kind_set(NodeKind::number, NodeKind::label, NodeKind::function);
+
+			static Opt<ConstantCtr> match(const ComputationNode &target) {
+				if (!is_dynamic_type<NumberCn, LabelCn, FunctionCn>(target)) {
+					return {};
+				}
+				return ConstantCtr { &target };
 			}
 		};
 
@@ -143,9 +195,14 @@ namespace L3::code_gen::tiles {
 		struct NumberCtr {
 			int64_t value;
 
-			static NumberCtr match(const ComputationNode &target) {
-				const NumberCn &number_node = unwrap_node_type<NumberCn>(target);
-				return { number_node.value };
+			static const NodeKindSet root_kinds = kind_set(NodeKind::number);
+
+			static Opt<NumberCtr> match(const ComputationNode &target) {
+				const NumberCn *number_node = dynamic_cast<const NumberCn *>(&target);
+				if (!number_node) {
+					return {};
+				}
+				return NumberCtr { number_node->value };
 			}
 		};
 
@@ -155,10 +212,15 @@ namespace L3::code_gen::tiles {
 		struct CallableCtr {
 			const ComputationNode *node;
 
-			static CallableCtr match(const ComputationNode &target) {
-				throw_unless(target.destination.has_value()
-					|| is_dynamic_type<FunctionCn>(target));
-				return { &target };
+			static const NodeKindSet root_kinds = ALL_NODE_KINDS; // anything can have a destination
+
+			static Opt<CallableCtr> match(const ComputationNode &target) {
+				if (!(target.destination.has_value()
+					|| is_dynamic_type<FunctionCn>(target)))
+				{
+					return {};
+				}
+				return CallableCtr { &target };
 			}
 		};
 
@@ -170,9 +232,17 @@ namespace L3::code_gen::tiles {
 			Variable *var;
 			NodeCtr node;
 
-			static VariableCtr match(const ComputationNode &target) {
-				throw_unless(target.destination.has_value());
-				return { *target.destination, NodeCtr::match(target) };
+			static const NodeKindSet root_kinds = NodeCtr::root_kinds;
+
+			static Opt<VariableCtr> match(const ComputationNode &target) {
+				if (!target.destination.has_value()) {
+					return {};
+				}
+				Opt<NodeCtr> node = NodeCtr::match(target);
+				if (!node) {
+					return {};
+				}
+				return VariableCtr { *target.destination, mv(*node) };
 			}
 		};
 
@@ -183,8 +253,14 @@ namespace L3::code_gen::tiles {
 			Opt<Variable *> maybe_var;
 			NodeCtr node;
 
-			static MaybeVariableCtr match(const ComputationNode &target) {
-				return { target.destination, NodeCtr::match(target) };
+			static const NodeKindSet root_kinds = NodeCtr::root_kinds;
+
+			static Opt<MaybeVariableCtr> match(const ComputationNode &target) {
+				Opt<NodeCtr> node = NodeCtr::match(target);
+				if (!node) {
+					return {};
+				}
+				return MaybeVariableCtr { target.destination, mv(*node) };
 			}
 		};
 
@@ -193,9 +269,18 @@ namespace L3::code_gen::tiles {
 		struct MoveCtr {
 			SourceCtr source;
 
-			static MoveCtr match(const ComputationNode &target) {
-				const MoveCn &move_node = unwrap_node_type<MoveCn>(target);
-				return { SourceCtr::match(*move_node.source) };
+			static const NodeKindSet root_kinds = kind_set(NodeKind::move);
+
+			static Opt<MoveCtr> match(const ComputationNode &target) {
+				const MoveCn *move_node = dynamic_cast<const MoveCn *>(&target);
+				if (!move_node) {
+					return {};
+				}
+				Opt<SourceCtr> source = SourceCtr::match(*move_node->source);
+				if (!source) {
+					return {};
+				}
+				return MoveCtr { mv(*source) };
 			}
 		};
 
@@ -208,22 +293,36 @@ namespace L3::code_gen::tiles {
 			LhsCtr lhs;
 			RhsCtr rhs;
 
-			static CommutativeBinaryCtr match(const ComputationNode &target) {
-				const BinaryCn &bin_node = unwrap_node_type<BinaryCn>(target);
-				try {
-					return {
-						bin_node.op,
-						LhsCtr::match(*bin_node.lhs),
-						RhsCtr::match(*bin_node.rhs)
-					};
-				} catch (MatchFailError &e) {
-					Operator flipped_op = unwrap_optional(flip_operator(bin_node.op));
-					return {
-						flipped_op,
-						LhsCtr::match(*bin_node.rhs),
-						RhsCtr::match(*bin_node.lhs)
-					};
+			static const NodeKindSet root_kinds = kind_set(NodeKind::binary);
+
+			static Opt<CommutativeBinaryCtr> match(const ComputationNode &target) {
+				const BinaryCn *bin_node = dynamic_cast<const BinaryCn *>(&target);
+				if (!bin_node) {
+					return {};
+				}
+				Opt<LhsCtr> lhs = LhsCtr::match(*bin_node->lhs);
+				Opt<RhsCtr> rhs;
+				if (lhs) {
+					rhs = RhsCtr::match(*bin_node->rhs);
+					if (rhs) {
+						return CommutativeBinaryCtr { bin_node->op, mv(*lhs), mv(*rhs) };
+					}
+				}
+
+				// try again with the operands the other way around
+				Opt<Operator> flipped_op = flip_operator(bin_node->op);
+				if (!flipped_op) {
+					return {};
+				}
+				lhs = LhsCtr::match(*bin_node->rhs);
+				if (!lhs) {
+					return {};
 				}
+				rhs = RhsCtr::match(*bin_node->lhs);
+				if (!rhs) {
+					return {};
+				}
+				return CommutativeBinaryCtr { *flipped_op, mv(*lhs), mv(*rhs) };
 			}
 		};
 
@@ -235,13 +334,22 @@ namespace L3::code_gen::tiles {
 			LhsCtr lhs;
 			RhsCtr rhs;
 
-			static NoncommutativeBinaryCtr match(const ComputationNode &target) {
-				const BinaryCn &bin_node = unwrap_node_type<BinaryCn>(target);
-				return {
-					bin_node.op,
-					LhsCtr::match(*bin_node.lhs),
-					RhsCtr::match(*bin_node.rhs)
-				};
+			static const NodeKindSet root_kinds = kind_set(NodeKind::binary);
+
+			static Opt<NoncommutativeBinaryCtr> match(const ComputationNode &target) {
+				const BinaryCn *bin_node = dynamic_cast<const BinaryCn *>(&target);
+				if (!bin_node) {
+					return {};
+				}
+				Opt<LhsCtr> lhs = LhsCtr::match(*bin_node->lhs);
+				if (!lhs) {
+					return {};
+				}
+				Opt<RhsCtr> rhs = RhsCtr::match(*bin_node->rhs);
+				if (!rhs) {
+					return {};
+				}
+				return NoncommutativeBinaryCtr { bin_node->op, mv(*lhs), mv(*rhs) };
 			}
 		};
 
@@ -250,11 +358,18 @@ namespace L3::code_gen::tiles {
 		struct LoadCtr {
 			AddressCtr address;
 
-			static LoadCtr match(const ComputationNode &target) {
-				const LoadCn &load_node = unwrap_node_type<LoadCn>(target);
-				return {
-					AddressCtr::match(*load_node.address)
-				};
+			static const NodeKindSet root_kinds = kind_set(NodeKind::load);
+
+			static Opt<LoadCtr> match(const ComputationNode &target) {
+				const LoadCn *load_node = dynamic_cast<const LoadCn *>(&target);
+				if (!load_node) {
+					return {};
+				}
+				Opt<AddressCtr> address = AddressCtr::match(*load_node->address);
+				if (!address) {
+					return {};
+				}
+				return LoadCtr { mv(*address) };
 			}
 		};
 
@@ -264,12 +379,51 @@ namespace L3::code_gen::tiles {
 			AddressCtr address;
 			SourceCtr source;
 
-			static StoreCtr match(const ComputationNode &target) {
-				const StoreCn &store_node = unwrap_node_type<StoreCn>(target);
-				return {
-					AddressCtr::match(*store_node.address),
-					SourceCtr::match(*store_node.value)
-				};
+			static const NodeKindSet root_kinds = kind_set(NodeKind::store);
+
+			static Opt<StoreCtr> match(const ComputationNode &target) {
+				const StoreCn *store_node = dynamic_cast<const StoreCn *>(&target);
+				if (!store_node) {
+					return {};
+				}
+				Opt<AddressCtr> address = AddressCtr::match(*store_node->address);
+				if (!address) {
+					return {};
+				}
+				Opt<SourceCtr> source = SourceCtr::match(*store_node->value);
+				if (!source) {
+					return {};
+				}
+				return StoreCtr { mv(*address), mv(*source) };
+			}
+		};
+
+		// Matches: an address that can be expressed as "x M" in L2, i.e. a
+		// node with a destination, optionally plus or minus a multiple of 8
+		// Captures: the node computing the base, and the offset
+		struct MemoryAddressCtr {
+			const ComputationNode *base;
+			int64_t offset;
+
+			static const NodeKindSet root_kinds = ALL_NODE_KINDS; // anything can have a destination
+
+			static Opt<MemoryAddressCtr> match(const ComputationNode &target) {
+				using OffsetAddressCtr = CommutativeBinaryCtr<VariableCtr<AnyCtr>, NumberCtr>;
+				Opt<OffsetAddressCtr> offset_address = OffsetAddressCtr::match(target);
+				if (offset_address
+					&& offset_address->rhs.value % 8 == 0
+					&& (offset_address->op == Operator::plus || offset_address->op == Operator::minus))
+				{
+					int64_t offset = offset_address->rhs.value;
+					if (offset_address->op == Operator::minus) {
+						offset *= -1;
+					}
+					return MemoryAddressCtr { offset_address->lhs.node.node, offset };
+				}
+				if (!target.destination.has_value()) {
+					return {};
+				}
+				return MemoryAddressCtr { &target, 0 };
 			}
 		};
 
@@ -278,12 +432,14 @@ namespace L3::code_gen::tiles {
 		struct UnconditionalBranchCtr {
 			BasicBlock *jmp_dest;
 
-			static UnconditionalBranchCtr match(const ComputationNode &target) {
-				const BranchCn &branch_node = unwrap_node_type<BranchCn>(target);
-				throw_unless(!branch_node.condition.has_value());
-				return {
-					branch_node.jmp_dest
-				};
+			static const NodeKindSet root_kinds = kind_set(NodeKind::branch);
+
+			static Opt<UnconditionalBranchCtr> match(const ComputationNode &target) {
+				const BranchCn *branch_node = dynamic_cast<const BranchCn *>(&target);
+				if (!branch_node || branch_node->condition.has_value()) {
+					return {};
+				}
+				return UnconditionalBranchCtr { branch_node->jmp_dest };
 			}
 		};
 
@@ -294,22 +450,31 @@ namespace L3::code_gen::tiles {
 			BasicBlock *jmp_dest;
 			ConditionCtr condition;
 
-			static ConditionalBranchCtr match(const ComputationNode &target) {
-				const BranchCn &branch_node = unwrap_node_type<BranchCn>(target);
-				const Uptr<ComputationNode> &condition = unwrap_optional(branch_node.condition);
-				return {
-					branch_node.jmp_dest,
-					ConditionCtr::match(*condition)
-				};
+			static const NodeKindSet root_kinds = kind_set(NodeKind::branch);
+
+			static Opt<ConditionalBranchCtr> match(const ComputationNode &target) {
+				const BranchCn *branch_node = dynamic_cast<const BranchCn *>(&target);
+				if (!branch_node || !branch_node->condition.has_value()) {
+					return {};
+				}
+				Opt<ConditionCtr> condition = ConditionCtr::match(**branch_node->condition);
+				if (!condition) {
+					return {};
+				}
+				return ConditionalBranchCtr { branch_node->jmp_dest, mv(*condition) };
 			}
 		};
 
 		// Matches: a ReturnCn without a value
 		struct ReturnVoidCtr {
-			static ReturnVoidCtr match(const ComputationNode &target) {
-				const ReturnCn &return_node = unwrap_node_type<ReturnCn>(target);
-				throw_unless(!return_node.value.has_value());
-				return {};
+			static const NodeKindSet root_kinds = kind_set(NodeKind::return_);
+
+			static Opt<ReturnVoidCtr> match(const ComputationNode &target) {
+				const ReturnCn *return_node = dynamic_cast<const ReturnCn *>(&target);
+				if (!return_node || return_node->value.has_value()) {
+					return {};
+				}
+				return ReturnVoidCtr {};
 			}
 		};
 
@@ -318,12 +483,18 @@ namespace L3::code_gen::tiles {
 		struct ReturnValCtr {
 			ValueCtr value;
 
-			static ReturnValCtr match(const ComputationNode &target) {
-				const ReturnCn &return_node = unwrap_node_type<ReturnCn>(target);
-				const Uptr<ComputationNode> &value = unwrap_optional(return_node.value);
-				return {
-					ValueCtr::match(*value)
-				};
+			static const NodeKindSet root_kinds = kind_set(NodeKind::return_);
+
+			static Opt<ReturnValCtr> match(const ComputationNode &target) {
+				const ReturnCn *return_node = dynamic_cast<const ReturnCn *>(&target);
+				if (!return_node || !return_node->value.has_value()) {
+					return {};
+				}
+				Opt<ValueCtr> value = ValueCtr::match(**return_node->value);
+				if (!value) {
+					return {};
+				}
+				return ReturnValCtr { mv(*value) };
 			}
 		};
 
@@ -334,31 +505,43 @@ namespace L3::code_gen::tiles {
 			CalleeCtr callee;
 			Vec<const ComputationNode *> arguments;
 
-			static CallCtr match(const ComputationNode &target) {
-				const CallCn &call_node = unwrap_node_type<CallCn>(target);
+			static const NodeKindSet root_kinds = kind_set(NodeKind::call);
+
+			static Opt<CallCtr> match(const ComputationNode &target) {
+				const CallCn *call_node = dynamic_cast<const CallCn *>(&target);
+				if (!call_node) {
+					return {};
+				}
+				Opt<CalleeCtr> callee = CalleeCtr::match(*call_node->callee);
+				if (!callee) {
+					return {};
+				}
 
 				Vec<const ComputationNode *> arguments;
-				for (const Uptr<ComputationNode> &arg : call_node.arguments) {
+				for (const ArenaUptr<ComputationNode> &arg : call_node->arguments) {
 					arguments.push_back(arg.get());
 				}
 
-				return {
-					CalleeCtr::match(*call_node.callee),
-					mv(arguments)
-				};
+				return CallCtr { mv(*callee), mv(arguments) };
 			}
 		};
 	}
 
 	// To be used for matching, a Tile subclass must have:
-	// - member type Structure where Structure::match(const ComputationTree &) works (can throw)
-	// - a constructor that takes a Structure and returns a Tile (can throw)
+	// - member type Structure which is a CTR
+	// - static method `bool accepts(const Structure &)` for any conditions
+	//   on the match that the Structure can't express (Tile's own accepts
+	//   every match)
+	// - a constructor that takes an accepted Structure and returns a Tile
 	// - static member int cost
 	// - static member int munch
 
 	namespace tile_patterns {
 		using namespace rules;
 		using L3::code_gen::target_arch::to_l2_expr;
+		using l2::Instruction;
+		using l2::Operand;
+		using l2::Register;
 
 		struct NoOp : Tile {
 			using Structure = NoOpCtr;
@@ -367,9 +550,7 @@ namespace L3::code_gen::tiles {
 			static const int munch = 0;
 			static const int cost = 0;
 
-			virtual Vec<std::string> to_l2_instructions() const override {
-				return {};
-			}
+			virtual void to_l2_instructions(FunctionContext &ctx, Vec<l2::Instruction> &out) const override {}
 			virtual Vec<const L3::program::ComputationNode *> get_unmatched() const override {
 				return {};
 			}
@@ -388,10 +569,8 @@ namespace L3::code_gen::tiles {
 			static const int munch = 1;
 			static const int cost = 1;
 
-			virtual Vec<std::string> to_l2_instructions() const override {
-				return {
-					to_l2_expr(this->dest) + " <- " + to_l2_expr(*this->source)
-				};
+			virtual void to_l2_instructions(FunctionContext &ctx, Vec<l2::Instruction> &out) const override {
+				out.push_back(Instruction::make_assign(to_l2_expr(this->dest), to_l2_expr(*this->source)));
 			}
 			virtual Vec<const L3::program::ComputationNode *> get_unmatched() const override {
 				return { this->source };
@@ -413,10 +592,8 @@ namespace L3::code_gen::tiles {
 			static const int munch = 1;
 			static const int cost = 1;
 
-			virtual Vec<std::string> to_l2_instructions() const override {
-				return {
-					to_l2_expr(this->dest) + " <- " + to_l2_expr(*this->source, true)
-				};
+			virtual void to_l2_instructions(FunctionContext &ctx, Vec<l2::Instruction> &out) const override {
+				out.push_back(Instruction::make_assign(to_l2_expr(this->dest), to_l2_expr(*this->source, true)));
 			}
 			virtual Vec<const L3::program::ComputationNode *> get_unmatched() const override {
 				// because the source is a constant, it is considered to have
@@ -442,26 +619,18 @@ namespace L3::code_gen::tiles {
 				op { s.node.op },
 				lhs { s.node.lhs.node },
 				rhs { s.node.rhs.node }
-			{
-				throw_unless(
-					this->op == Operator::plus
-					|| this->op == Operator::minus
-					|| this->op == Operator::times
-					|| this->op == Operator::bitwise_and
-					|| this->op == Operator::lshift
-					|| this->op == Operator::rshift
-				);
+			{}
+			static bool accepts(const Structure &s) {
+				return is_arithmetic_operator(s.node.op);
 			}
 
 			static const int munch = 1;
 			static const int cost = 3;
 
-			virtual Vec<std::string> to_l2_instructions() const override {
-				return {
-					"%_ <- " + to_l2_expr(*this->lhs),
-					"%_ " + program::to_string(this->op) + "= " + to_l2_expr(*this->rhs),
-					to_l2_expr(this->dest) + " <- %_"
-				};
+			virtual void to_l2_instructions(FunctionContext &ctx, Vec<l2::Instruction> &out) const override {
+				out.push_back(Instruction::make_assign(Operand::make_temp(), to_l2_expr(*this->lhs)));
+				out.push_back(Instruction::make_assign_op(Operand::make_temp(), this->op, to_l2_expr(*this->rhs)));
+				out.push_back(Instruction::make_assign(to_l2_expr(this->dest), Operand::make_temp()));
 			}
 			virtual Vec<const L3::program::ComputationNode *> get_unmatched() const override {
 				return { this->lhs, this->rhs };
@@ -485,26 +654,18 @@ namespace L3::code_gen::tiles {
 				op { s.node.op },
 				lhs { s.node.lhs.node },
 				rhs { s.node.rhs.node }
-			{
-				throw_unless(
-					this->op == Operator::plus
-					|| this->op == Operator::minus
-					|| this->op == Operator::times
-					|| this->op == Operator::bitwise_and
-					|| this->op == Operator::lshift
-					|| this->op == Operator::rshift
-				);
-				throw_unless(!this->rhs->destination.has_value() || this->dest != *this->rhs->destination);
+			{}
+			static bool accepts(const Structure &s) {
+				return is_arithmetic_operator(s.node.op)
+					&& (!s.node.rhs.node->destination.has_value() || s.var != *s.node.rhs.node->destination);
 			}
 
 			static const int munch = 1;
 			static const int cost = 2;
 
-			virtual Vec<std::string> to_l2_instructions() const override {
-				return {
-					to_l2_expr(this->dest) + " <- " + to_l2_expr(*this->lhs),
-					to_l2_expr(this->dest) + " " + program::to_string(this->op) + "= " + to_l2_expr(*this->rhs)
-				};
+			virtual void to_l2_instructions(FunctionContext &ctx, Vec<l2::Instruction> &out) const override {
+				out.push_back(Instruction::make_assign(to_l2_expr(this->dest), to_l2_expr(*this->lhs)));
+				out.push_back(Instruction::make_assign_op(to_l2_expr(this->dest), this->op, to_l2_expr(*this->rhs)));
 			}
 			virtual Vec<const L3::program::ComputationNode *> get_unmatched() const override {
 				return { this->lhs, this->rhs };
@@ -529,43 +690,39 @@ namespace L3::code_gen::tiles {
 				lhs { s.node.lhs.node },
 				rhs { s.node.rhs.node }
 			{
-				throw_unless(
-					this->op == Operator::plus
-					|| this->op == Operator::minus
-					|| this->op == Operator::times
-					|| this->op == Operator::bitwise_and
-					|| this->op == Operator::lshift
-					|| this->op == Operator::rshift
-				);
-				bool assign_to_lhs = this->lhs->destination.has_value() && this->dest == *this->lhs->destination;
-				if (!assign_to_lhs) {
-					// see if we assign to rhs instead by swapping the operands
-					if (
-						this->rhs->destination.has_value()
-						&& this->dest == *this->rhs->destination // the rhs must equal the destination
-						&& !( // and the operator must not be noncommutative
-							this->op == Operator::minus
-							|| this->op == Operator::lshift
-							|| this->op == Operator::rshift
-						)
-					) {
-						// swap lhs and rhs in this tile
-						const ComputationNode *temp = this->rhs;
-						this->rhs = this->lhs;
-						this->lhs = temp;
-					} else {
-						fail_match();
-					}
+				if (!assigns_to_lhs(s)) {
+					// accepts() guarantees that we assign to the rhs instead,
+					// so swap lhs and rhs in this tile
+					const ComputationNode *temp = this->rhs;
+					this->rhs = this->lhs;
+					this->lhs = temp;
 				}
 			}
+			static bool assigns_to_lhs(const Structure &s) {
+				return s.node.lhs.node->destination.has_value() && s.var == *s.node.lhs.node->destination;
+			}
+			static bool accepts(const Structure &s) {
+				if (!is_arithmetic_operator(s.node.op)) {
+					return false;
+				}
+				if (assigns_to_lhs(s)) {
+					return true;
+				}
+				// see if we assign to rhs instead by swapping the operands
+				return s.node.rhs.node->destination.has_value()
+					&& s.var == *s.node.rhs.node->destination // the rhs must equal the destination
+					&& !( // and the operator must not be noncommutative
+						s.node.op == Operator::minus
+						|| s.node.op == Operator::lshift
+						|| s.node.op == Operator::rshift
+					);
+			}
 
 			static const int munch = 1;
 			static const int cost = 1;
 
-			virtual Vec<std::string> to_l2_instructions() const override {
-				return {
-					to_l2_expr(this->dest) + " " + program::to_string(this->op) + "= " + to_l2_expr(*this->rhs)
-				};
+			virtual void to_l2_instructions(FunctionContext &ctx, Vec<l2::Instruction> &out) const override {
+				out.push_back(Instruction::make_assign_op(to_l2_expr(this->dest), this->op, to_l2_expr(*this->rhs)));
 			}
 			virtual Vec<const L3::program::ComputationNode *> get_unmatched() const override {
 				return { this->lhs, this->rhs };
@@ -592,32 +749,32 @@ namespace L3::code_gen::tiles {
 				base { s.node.lhs.node.node },
 				offset { s.node.rhs.lhs.node.node },
 				shift_amt { s.node.rhs.rhs.value }
-			{
-				throw_unless(
-					s.node.op == Operator::plus && (
-						(s.node.rhs.op == Operator::lshift && (
-							this->shift_amt == 0
-							|| this->shift_amt == 1
-							|| this->shift_amt == 2
-							|| this->shift_amt == 3
-						)) || (s.node.rhs.op == Operator::rshift && (
-							this->shift_amt == 0
-						))
-					)
+			{}
+			static bool accepts(const Structure &s) {
+				int64_t shift_amt = s.node.rhs.rhs.value;
+				return s.node.op == Operator::plus && (
+					(s.node.rhs.op == Operator::lshift && (
+						shift_amt == 0
+						|| shift_amt == 1
+						|| shift_amt == 2
+						|| shift_amt == 3
+					)) || (s.node.rhs.op == Operator::rshift && (
+						shift_amt == 0
+					))
 				);
 			}
 
 			static const int munch = 2;
 			static const int cost = 1;
 
-			virtual Vec<std::string> to_l2_instructions() const override {
+			virtual void to_l2_instructions(FunctionContext &ctx, Vec<l2::Instruction> &out) const override {
 				int64_t scale = 1 << this->shift_amt;
-				return {
-					to_l2_expr(this->dest) +
-					" @ " + to_l2_expr(*this->base) +
-					" " + to_l2_expr(*this->offset) +
-					" " + to_l2_expr(scale)
-				};
+				out.push_back(Instruction::make_lea(
+					to_l2_expr(this->dest),
+					to_l2_expr(*this->base),
+					to_l2_expr(*this->offset),
+					scale
+				));
 			}
 			virtual Vec<const L3::program::ComputationNode *> get_unmatched() const override {
 				return { this->base, this->offset };
@@ -644,27 +801,27 @@ namespace L3::code_gen::tiles {
 				base { s.node.lhs.node.node },
 				offset { s.node.rhs.lhs.node.node },
 				scale { s.node.rhs.rhs.value }
-			{
-				throw_unless(
-					s.node.op == Operator::plus
+			{}
+			static bool accepts(const Structure &s) {
+				int64_t scale = s.node.rhs.rhs.value;
+				return s.node.op == Operator::plus
 					&& s.node.rhs.op == Operator::times
-					&& (this->scale == 1
-						|| this->scale == 2
-						|| this->scale == 4
-						|| this->scale == 8)
-				);
+					&& (scale == 1
+						|| scale == 2
+						|| scale == 4
+						|| scale == 8);
 			}
 
 			static const int munch = 2;
 			static const int cost = 1;
 
-			virtual Vec<std::string> to_l2_instructions() const override {
-				return {
-					to_l2_expr(this->dest) +
-					" @ " + to_l2_expr(*this->base) +
-					" " + to_l2_expr(*this->offset) +
-					" " + to_l2_expr(this->scale)
-				};
+			virtual void to_l2_instructions(FunctionContext &ctx, Vec<l2::Instruction> &out) const override {
+				out.push_back(Instruction::make_lea(
+					to_l2_expr(this->dest),
+					to_l2_expr(*this->base),
+					to_l2_expr(*this->offset),
+					this->scale
+				));
 			}
 			virtual Vec<const L3::program::ComputationNode *> get_unmatched() const override {
 				return { this->base, this->offset };
@@ -688,20 +845,15 @@ namespace L3::code_gen::tiles {
 				op { s.node.op },
 				lhs { s.node.lhs.node },
 				rhs { s.node.rhs.node }
-			{
-				throw_unless(
-					this->op == Operator::lt
-					|| this->op == Operator::le
-					|| this->op == Operator::eq
-					|| this->op == Operator::ge
-					|| this->op == Operator::gt
-				);
+			{}
+			static bool accepts(const Structure &s) {
+				return is_comparison_operator(s.node.op);
 			}
 
 			static const int munch = 1;
 			static const int cost = 1;
 
-			virtual Vec<std::string> to_l2_instructions() const override {
+			virtual void to_l2_instructions(FunctionContext &ctx, Vec<l2::Instruction> &out) const override {
 				// if we use gt or ge, mirror the operator and swap the operands
 				const ComputationNode *lhs_ptr = this->lhs;
 				const ComputationNode *rhs_ptr = this->rhs;
@@ -720,12 +872,12 @@ namespace L3::code_gen::tiles {
 					// default cause is to do nothing
 				}
 
-				return {
-					to_l2_expr(this->dest) + " <- "
-					+ to_l2_expr(*lhs_ptr) + " "
-					+ program::to_string(l2_op) + " "
-					+ to_l2_expr(*rhs_ptr)
-				};
+				out.push_back(Instruction::make_assign_compare(
+					to_l2_expr(this->dest),
+					to_l2_expr(*lhs_ptr),
+					l2_op,
+					to_l2_expr(*rhs_ptr)
+				));
 			}
 			virtual Vec<const L3::program::ComputationNode *> get_unmatched() const override {
 				return { this->lhs, this->rhs };
@@ -750,20 +902,15 @@ namespace L3::code_gen::tiles {
 				op { s.condition.op },
 				lhs { s.condition.lhs.node },
 				rhs { s.condition.rhs.node }
-			{
-				throw_unless(
-					this->op == Operator::lt
-					|| this->op == Operator::le
-					|| this->op == Operator::eq
-					|| this->op == Operator::ge
-					|| this->op == Operator::gt
-				);
+			{}
+			static bool accepts(const Structure &s) {
+				return is_comparison_operator(s.condition.op);
 			}
 
 			static const int munch = 2;
 			static const int cost = 1;
 
-			virtual Vec<std::string> to_l2_instructions() const override {
+			virtual void to_l2_instructions(FunctionContext &ctx, Vec<l2::Instruction> &out) const override {
 				// if we use gt or ge, mirror the operator and swap the operands
 				const ComputationNode *lhs_ptr = this->lhs;
 				const ComputationNode *rhs_ptr = this->rhs;
@@ -782,13 +929,12 @@ namespace L3::code_gen::tiles {
 					// default cause is to do nothing
 				}
 
-				return {
-					"cjump "
-					+ to_l2_expr(*lhs_ptr) + " "
-					+ program::to_string(l2_op) + " "
-					+ to_l2_expr(*rhs_ptr) + " "
-					+ to_l2_expr(this->jmp_dest)
-				};
+				out.push_back(Instruction::make_cjump(
+					to_l2_expr(*lhs_ptr),
+					l2_op,
+					to_l2_expr(*rhs_ptr),
+					to_l2_expr(this->jmp_dest)
+				));
 			}
 			virtual Vec<const L3::program::ComputationNode *> get_unmatched() const override {
 				return { this->lhs, this->rhs };
@@ -812,10 +958,8 @@ namespace L3::code_gen::tiles {
 			static const int munch = 1;
 			static const int cost = 1;
 
-			virtual Vec<std::string> to_l2_instructions() const override {
-				return {
-					to_l2_expr(this->dest) + " <- mem " + to_l2_expr(*this->address) + " 0"
-				};
+			virtual void to_l2_instructions(FunctionContext &ctx, Vec<l2::Instruction> &out) const override {
+				out.push_back(Instruction::make_load(to_l2_expr(this->dest), to_l2_expr(*this->address), 0));
 			}
 			virtual Vec<const L3::program::ComputationNode *> get_unmatched() const override {
 				return { this->address };
@@ -840,25 +984,20 @@ namespace L3::code_gen::tiles {
 				base { s.node.address.lhs.node.node },
 				offset { s.node.address.rhs.value }
 			{
-				throw_unless(this->offset % 8 == 0);
-				switch (s.node.address.op) {
-					case Operator::plus:
-						break;
-					case Operator::minus:
-						this->offset *= -1;
-						break;
-					default:
-						fail_match();
+				if (s.node.address.op == Operator::minus) {
+					this->offset *= -1;
 				}
 			}
+			static bool accepts(const Structure &s) {
+				return s.node.address.rhs.value % 8 == 0
+					&& (s.node.address.op == Operator::plus || s.node.address.op == Operator::minus);
+			}
 
 			static const int munch = 2;
 			static const int cost = 1;
 
-			virtual Vec<std::string> to_l2_instructions() const override {
-				return {
-					to_l2_expr(this->dest) + " <- mem " + to_l2_expr(*this->base) + " " + to_l2_expr(this->offset)
-				};
+			virtual void to_l2_instructions(FunctionContext &ctx, Vec<l2::Instruction> &out) const override {
+				out.push_back(Instruction::make_load(to_l2_expr(this->dest), to_l2_expr(*this->base), this->offset));
 			}
 			virtual Vec<const L3::program::ComputationNode *> get_unmatched() const override {
 				return { this->base };
@@ -881,10 +1020,8 @@ namespace L3::code_gen::tiles {
 			static const int munch = 1;
 			static const int cost = 1;
 
-			virtual Vec<std::string> to_l2_instructions() const override {
-				return {
-					"mem " + to_l2_expr(*this->address) + " 0 <- " + to_l2_expr(*this->source)
-				};
+			virtual void to_l2_instructions(FunctionContext &ctx, Vec<l2::Instruction> &out) const override {
+				out.push_back(Instruction::make_store(to_l2_expr(*this->address), 0, to_l2_expr(*this->source)));
 			}
 			virtual Vec<const L3::program::ComputationNode *> get_unmatched() const override {
 				return { this->address, this->source };
@@ -908,25 +1045,150 @@ namespace L3::code_gen::tiles {
 				offset { s.address.rhs.value },
 				source { s.source.node }
 			{
-				throw_unless(this->offset % 8 == 0);
-				switch (s.address.op) {
-					case Operator::plus:
-						break;
-					case Operator::minus:
-						this->offset *= -1;
-						break;
-					default:
-						fail_match();
+				if (s.address.op == Operator::minus) {
+					this->offset *= -1;
 				}
 			}
+			static bool accepts(const Structure &s) {
+				return s.address.rhs.value % 8 == 0
+					&& (s.address.op == Operator::plus || s.address.op == Operator::minus);
+			}
+
+			static const int munch = 2;
+			static const int cost = 1;
+
+			virtual void to_l2_instructions(FunctionContext &ctx, Vec<l2::Instruction> &out) const override {
+				out.push_back(Instruction::make_store(to_l2_expr(*this->base), this->offset, to_l2_expr(*this->source)));
+			}
+			virtual Vec<const L3::program::ComputationNode *> get_unmatched() const override {
+				return { this->base, this->source };
+			}
+		};
+
+		// whether the arithmetic operator can be applied with a memory operand
+		// in L2
+		bool is_memory_arithmetic_operator(Operator op) {
+			return op == Operator::plus || op == Operator::minus;
+		}
+
+		struct LoadArithmeticAssignmentInPlace : Tile {
+			Variable *dest;
+			Operator op;
+			const ComputationNode *lhs;
+			const ComputationNode *base;
+			int64_t offset;
+
+			using Structure = VariableCtr<
+				CommutativeBinaryCtr<
+					InexplicableTCtr,
+					LoadCtr<MemoryAddressCtr>
+				>
+			>;
+			LoadArithmeticAssignmentInPlace(Structure s) :
+				dest { s.var },
+				op { s.node.op },
+				lhs { s.node.lhs.node },
+				base { s.node.rhs.address.base },
+				offset { s.node.rhs.address.offset }
+			{}
+			static bool accepts(const Structure &s) {
+				return is_memory_arithmetic_operator(s.node.op)
+					&& s.node.lhs.node->destination.has_value()
+					&& s.var == *s.node.lhs.node->destination;
+			}
+
+			static const int munch = 2;
+			static const int cost = 1;
+
+			virtual void to_l2_instructions(FunctionContext &ctx, Vec<l2::Instruction> &out) const override {
+				out.push_back(Instruction::make_load_op(to_l2_expr(this->dest), this->op, to_l2_expr(*this->base), this->offset));
+			}
+			virtual Vec<const L3::program::ComputationNode *> get_unmatched() const override {
+				return { this->lhs, this->base };
+			}
+		};
+
+		struct LoadArithmeticAssignmentDistinct : Tile {
+			Variable *dest;
+			Operator op;
+			const ComputationNode *lhs;
+			const ComputationNode *base;
+			int64_t offset;
+
+			using Structure = VariableCtr<
+				CommutativeBinaryCtr<
+					InexplicableTCtr,
+					LoadCtr<MemoryAddressCtr>
+				>
+			>;
+			LoadArithmeticAssignmentDistinct(Structure s) :
+				dest { s.var },
+				op { s.node.op },
+				lhs { s.node.lhs.node },
+				base { s.node.rhs.address.base },
+				offset { s.node.rhs.address.offset }
+			{}
+			static bool accepts(const Structure &s) {
+				// the address must still be intact after dest is overwritten
+				// with the lhs
+				return is_memory_arithmetic_operator(s.node.op)
+					&& s.var != *s.node.rhs.address.base->destination;
+			}
 
 			static const int munch = 2;
+			static const int cost = 2;
+
+			virtual void to_l2_instructions(FunctionContext &ctx, Vec<l2::Instruction> &out) const override {
+				out.push_back(Instruction::make_assign(to_l2_expr(this->dest), to_l2_expr(*this->lhs)));
+				out.push_back(Instruction::make_load_op(to_l2_expr(this->dest), this->op, to_l2_expr(*this->base), this->offset));
+			}
+			virtual Vec<const L3::program::ComputationNode *> get_unmatched() const override {
+				return { this->lhs, this->base };
+			}
+		};
+
+		// load, modify, and store back to the same address in one instruction
+		struct StoreArithmetic : Tile {
+			const ComputationNode *base;
+			int64_t offset;
+			Operator op;
+			const ComputationNode *source;
+
+			using Structure = StoreCtr<
+				MemoryAddressCtr,
+				CommutativeBinaryCtr<
+					LoadCtr<MemoryAddressCtr>,
+					InexplicableTCtr
+				>
+			>;
+			StoreArithmetic(Structure s) :
+				base { s.address.base },
+				offset { s.address.offset },
+				op { s.source.op },
+				source { s.source.rhs.node }
+			{}
+			static bool accepts(const Structure &s) {
+				// The load and the store must use the same address. The bases
+				// are compared by the variable they read, so they must be plain
+				// variables rather than something computed in the tree. The
+				// source must not overwrite that variable either, since it is
+				// computed before this tile.
+				const ComputationNode *store_base = s.address.base;
+				const ComputationNode *load_base = s.source.lhs.address.base;
+				Variable *base_var = *store_base->destination;
+				return is_memory_arithmetic_operator(s.source.op)
+					&& is_dynamic_type<VariableCn>(*store_base)
+					&& is_dynamic_type<VariableCn>(*load_base)
+					&& base_var == *load_base->destination
+					&& s.address.offset == s.source.lhs.address.offset
+					&& (!s.source.rhs.node->destination.has_value() || *s.source.rhs.node->destination != base_var);
+			}
+
+			static const int munch = 3;
 			static const int cost = 1;
 
-			virtual Vec<std::string> to_l2_instructions() const override {
-				return {
-					"mem " + to_l2_expr(*this->base) + " " + to_l2_expr(this->offset) + " <- " + to_l2_expr(*this->source)
-				};
+			virtual void to_l2_instructions(FunctionContext &ctx, Vec<l2::Instruction> &out) const override {
+				out.push_back(Instruction::make_store_op(to_l2_expr(*this->base), this->offset, this->op, to_l2_expr(*this->source)));
 			}
 			virtual Vec<const L3::program::ComputationNode *> get_unmatched() const override {
 				return { this->base, this->source };
@@ -944,8 +1206,8 @@ namespace L3::code_gen::tiles {
 			static const int munch = 1;
 			static const int cost = 1;
 
-			virtual Vec<std::string> to_l2_instructions() const override {
-				return { "goto " + to_l2_expr(this->jmp_dest) };
+			virtual void to_l2_instructions(FunctionContext &ctx, Vec<l2::Instruction> &out) const override {
+				out.push_back(Instruction::make_goto(to_l2_expr(this->jmp_dest)));
 			}
 			virtual Vec<const L3::program::ComputationNode *> get_unmatched() const override {
 				return {};
@@ -967,10 +1229,13 @@ namespace L3::code_gen::tiles {
 			static const int munch = 1;
 			static const int cost = 1;
 
-			virtual Vec<std::string> to_l2_instructions() const override {
-				return {
-					"cjump " + to_l2_expr(*this->condition) + " = 1 " + to_l2_expr(this->jmp_dest)
-				};
+			virtual void to_l2_instructions(FunctionContext &ctx, Vec<l2::Instruction> &out) const override {
+				out.push_back(Instruction::make_cjump(
+					to_l2_expr(*this->condition),
+					Operator::eq,
+					Operand::make_number(1),
+					to_l2_expr(this->jmp_dest)
+				));
 			}
 			virtual Vec<const L3::program::ComputationNode *> get_unmatched() const override {
 				return { this->condition };
@@ -984,8 +1249,8 @@ namespace L3::code_gen::tiles {
 			static const int munch = 1;
 			static const int cost = 1;
 
-			virtual Vec<std::string> to_l2_instructions() const override {
-				return { "return" };
+			virtual void to_l2_instructions(FunctionContext &ctx, Vec<l2::Instruction> &out) const override {
+				out.push_back(Instruction::make_return());
 			}
 			virtual Vec<const L3::program::ComputationNode *> get_unmatched() const override {
 				return {};
@@ -1008,11 +1273,9 @@ namespace L3::code_gen::tiles {
 			static const int munch = 1;
 			static const int cost = 2;
 
-			virtual Vec<std::string> to_l2_instructions() const override {
-				return {
-					"rax <- " + to_l2_expr(*this->value),
-					"return"
-				};
+			virtual void to_l2_instructions(FunctionContext &ctx, Vec<l2::Instruction> &out) const override {
+				out.push_back(Instruction::make_assign(Operand::make_register(Register::rax), to_l2_expr(*this->value)));
+				out.push_back(Instruction::make_return());
 			}
 			virtual Vec<const L3::program::ComputationNode *> get_unmatched() const override {
 				return { this->value };
@@ -1036,43 +1299,35 @@ namespace L3::code_gen::tiles {
 			static const int munch = 1;
 			static const int cost = 1;
 
-			virtual Vec<std::string> to_l2_instructions() const override {
-				static int num_call_return_labels = 0; // the number of call-return labels we've seen so far
-				static const std::string call_return_label_prefix = ":callret";
-
-				Vec<std::string> result;
-
+			virtual void to_l2_instructions(FunctionContext &ctx, Vec<l2::Instruction> &out) const override {
 				// add the instructions preparing the arguments
 				for (int i = 0; i < this->arguments.size(); ++i) {
-					result.push_back(target_arch::get_argument_prepping_instruction(
+					out.push_back(target_arch::get_argument_prepping_instruction(
 						to_l2_expr(*this->arguments[i]),
 						i
 					));
 				}
 
-				// add the actual call instruction
-				result.push_back("call " + to_l2_expr(*this->callee) + " " + std::to_string(this->arguments.size()));
-
 				// wrap in return label if the function is not an std function
 				const FunctionCn *maybe_fun_cn_ptr = dynamic_cast<const FunctionCn *>(this->callee);
 				bool is_std = maybe_fun_cn_ptr && dynamic_cast<const ExternalFunction *>(maybe_fun_cn_ptr->function);
+				Opt<Operand> return_label;
 				if (!is_std) {
-					std::string return_label = call_return_label_prefix + std::to_string(num_call_return_labels);
-					num_call_return_labels += 1;
+					return_label = Operand::make_call_return_label(ctx.num_call_return_labels);
+					ctx.num_call_return_labels += 1;
+					out.push_back(Instruction::make_store(Operand::make_register(Register::rsp), -8, *return_label));
+				}
 
-					result.insert(
-						result.end() - 1, // insert before the call instruction
-						"mem rsp -8 <- " + return_label
-					);
-					result.push_back(mv(return_label));
+				// add the actual call instruction
+				out.push_back(Instruction::make_call(to_l2_expr(*this->callee), this->arguments.size()));
+				if (return_label) {
+					out.push_back(Instruction::make_label(*return_label));
 				}
 
 				// store the return value if the call returns something
 				if (this->maybe_dest) {
-					result.push_back(to_l2_expr(*this->maybe_dest) + " <- rax");
+					out.push_back(Instruction::make_assign(to_l2_expr(*this->maybe_dest), Operand::make_register(Register::rax)));
 				}
-
-				return result;
 			}
 			virtual Vec<const ComputationNode *> get_unmatched() const override {
 				Vec<const ComputationNode *> result = this->arguments;
@@ -1084,60 +1339,199 @@ namespace L3::code_gen::tiles {
 
 	namespace tp = tile_patterns;
 
-	template<typename TP>
-	Opt<Uptr<TP>> attempt_tile_match(const ComputationNode &target) {
-		try {
-			return mkuptr<TP>(TP::Structure::match(target));
-		} catch (MatchFailError &e) {
-			return {};
-		}
-	}
-
+	// Attempts to match the tile pattern TP on the tree, replacing `out` if
+	// it matches better than the best match so far.
 	template<typename TP>
 	void attempt_tile_match(const ComputationNode &tree, Opt<Uptr<Tile>> &out, int &best_munch, int &best_cost) {
 		if (TP::munch > best_munch || (TP::munch == best_munch && TP::cost <= best_cost)) {
-			Opt<Uptr<TP>> result = attempt_tile_match<TP>(tree);
-			if (result) {
-				out = mv(*result);
+			Opt<typename TP::Structure> structure = TP::Structure::match(tree);
+			if (structure && TP::accepts(*structure)) {
+				out = mkuptr<TP>(mv(*structure));
 				best_munch = TP::munch;
 				best_cost = TP::cost;
 			}
 		}
 	}
-	template<typename... TPs>
-	void attempt_tile_matches(const ComputationNode &tree, Opt<Uptr<Tile>> &out, int &best_munch, int &best_cost) {
-		(attempt_tile_match<TPs>(tree, out, best_munch, best_cost), ...);
+
+	// a tile that matched the root of a tree, for the optimal tiler to weigh
+	// against the other matches
+	struct TileCandidate {
+		Uptr<Tile> tile;
+		int munch;
+		int cost;
+	};
+
+	// Appends a candidate to `out` if the tile pattern TP matches the tree.
+	template<typename TP>
+	void collect_tile_match(const ComputationNode &tree, Vec<TileCandidate> &out) {
+		Opt<typename TP::Structure> structure = TP::Structure::match(tree);
+		if (structure && TP::accepts(*structure)) {
+			out.push_back({ mkuptr<TP>(mv(*structure)), TP::munch, TP::cost });
+		}
 	}
 
+	using TileMatcher = void (*)(const ComputationNode &, Opt<Uptr<Tile>> &, int &, int &);
+	using TileCollector = void (*)(const ComputationNode &, Vec<TileCandidate> &);
+	template<typename Matcher>
+	using MatcherTable = std::array<Vec<Matcher>, NUM_NODE_KINDS>;
+
+	// Builds a table which lists, for each kind of root node, the matchers
+	// of only the tile patterns whose root can match that kind of node. Each
+	// list keeps the relative order of the patterns, since later patterns
+	// win ties. `matchers` pairs each matcher with the root kinds of its
+	// pattern.
+	template<typename Matcher>
+	MatcherTable<Matcher> build_matcher_table(const Vec<Pair<NodeKindSet, Matcher>> &matchers) {
+		MatcherTable<Matcher> table;
+		for (int kind = 0; kind < NUM_NODE_KINDS; ++kind) {
+			NodeKindSet kind_bit = kind_set(static_cast<NodeKind>(kind));
+			for (const auto &[root_kinds, matcher] : matchers) {
+				if (root_kinds & kind_bit) {
+					table[kind].push_back(matcher);
+				}
+			}
+		}
+		return table;
+	}
+
+	template<typename... TPs>
+	struct TilePatternList {
+		static MatcherTable<TileMatcher> build_greedy_table() {
+			return build_matcher_table<TileMatcher>({
+				{ TPs::Structure::root_kinds, &attempt_tile_match<TPs> }...
+			});
+		}
+		static MatcherTable<TileCollector> build_optimal_table() {
+			return build_matcher_table<TileCollector>({
+				{ TPs::Structure::root_kinds, &collect_tile_match<TPs> }...
+			});
+		}
+	};
+
+	using AllTilePatterns = TilePatternList<
+		tp::NoOp,
+		tp::PureAssignment,
+		tp::ConstantAssignment,
+		tp::BinaryArithmeticAssignment,
+		tp::BinaryArithmeticAssignmentDistinct,
+		tp::BinaryArithmeticAssignmentInPlace,
+		tp::LeaMultiply,
+		tp::LeaShift,
+		tp::BinaryCompareAssignment,
+		tp::BinaryCompareJump,
+		tp::PureLoad,
+		tp::LoadWithOffset,
+		tp::PureStore,
+		tp::StoreWithOffset,
+		tp::LoadArithmeticAssignmentInPlace,
+		tp::LoadArithmeticAssignmentDistinct,
+		tp::StoreArithmetic,
+		tp::GotoStatement,
+		tp::PureConditionalBranch,
+		tp::ReturnVoid,
+		tp::ReturnVal,
+		tp::Call
+	>;
+
+	// maximal munch: the tile that covers the most of the root, breaking
+	// ties by the lowest cost of the tile alone
 	Opt<Uptr<Tile>> find_best_tile(const ComputationNode &tree) {
+		static const MatcherTable<TileMatcher> matcher_table = AllTilePatterns::build_greedy_table();
+
 		Opt<Uptr<Tile>> best_match;
 		int best_munch = 0;
 		int best_cost = 0;
-		attempt_tile_matches<
-			tp::NoOp,
-			tp::PureAssignment,
-			tp::ConstantAssignment,
-			tp::BinaryArithmeticAssignment,
-			tp::BinaryArithmeticAssignmentDistinct,
-			tp::BinaryArithmeticAssignmentInPlace,
-			tp::LeaMultiply,
-			tp::LeaShift,
-			tp::BinaryCompareAssignment,
-			tp::BinaryCompareJump,
-			tp::PureLoad,
-			tp::LoadWithOffset,
-			tp::PureStore,
-			tp::StoreWithOffset,
-			tp::GotoStatement,
-			tp::PureConditionalBranch,
-			tp::ReturnVoid,
-			tp::ReturnVal,
-			tp::Call
-		>(tree, best_match, best_munch, best_cost);
+		for (TileMatcher matcher : matcher_table[static_cast<int>(get_node_kind(tree))]) {
+			matcher(tree, best_match, best_munch, best_cost);
+		}
 		return best_match;
 	}
 
-	Vec<Uptr<Tile>> tile_trees(const Vec<ComputationTreeBox> &tree_boxes) {
+	// the cheapest tile found for the root of a subtree, and the total cost
+	// of tiling the whole subtree when that tile is used
+	struct OptimalTiling {
+		Opt<Uptr<Tile>> tile; // empty if the subtree can't be tiled
+		int total_cost;
+	};
+	using OptimalTilings = Map<const ComputationNode *, OptimalTiling>;
+
+	// Bottom-up dynamic programming over the tree: the cost of a subtree is
+	// the lowest, over the tiles that match its root, of the tile's cost
+	// plus the costs of the subtrees it leaves unmatched. The best tiling of
+	// every subtree that was considered is recorded in `tilings`. Returns
+	// the total cost of the tree, or an empty optional if no combination of
+	// tiles covers it.
+	Opt<int> find_optimal_tiling(const ComputationNode &tree, OptimalTilings &tilings) {
+		static const MatcherTable<TileCollector> collector_table = AllTilePatterns::build_optimal_table();
+
+		if (auto it = tilings.find(&tree); it != tilings.end()) {
+			if (!it->second.tile) {
+				return {};
+			}
+			return it->second.total_cost;
+		}
+
+		Vec<TileCandidate> candidates;
+		for (TileCollector collector : collector_table[static_cast<int>(get_node_kind(tree))]) {
+			collector(tree, candidates);
+		}
+
+		OptimalTiling best { {}, 0 };
+		int best_munch = 0;
+		for (TileCandidate &candidate : candidates) {
+			int total_cost = candidate.cost;
+			bool is_coverable = true;
+			for (const ComputationNode *unmatched : candidate.tile->get_unmatched()) {
+				Opt<int> unmatched_cost = find_optimal_tiling(*unmatched, tilings);
+				if (!unmatched_cost) {
+					is_coverable = false;
+					break;
+				}
+				total_cost += *unmatched_cost;
+			}
+			if (!is_coverable) {
+				continue;
+			}
+			// like the greedy tiler, ties go to the larger munch and then
+			// to the later pattern
+			if (!best.tile
+				|| total_cost < best.total_cost
+				|| (total_cost == best.total_cost && candidate.munch >= best_munch))
+			{
+				best.tile = mv(candidate.tile);
+				best.total_cost = total_cost;
+				best_munch = candidate.munch;
+			}
+		}
+
+		Opt<int> result;
+		if (best.tile) {
+			result = best.total_cost;
+		}
+		tilings.insert_or_assign(&tree, mv(best));
+		return result;
+	}
+
+	Vec<Uptr<Tile>> tile_trees(const Vec<ComputationTreeBox> &tree_boxes, TilingStrategy strategy) {
+		// with the optimal strategy, every tree is solved up front and the
+		// tiles are then taken out of the solution
+		OptimalTilings optimal_tilings;
+		if (strategy == TilingStrategy::optimal) {
+			for (const ComputationTreeBox &tree_box : tree_boxes) {
+				find_optimal_tiling(*tree_box.get_tree(), optimal_tilings);
+			}
+		}
+		auto choose_tile = [&](const ComputationNode &tree) -> Opt<Uptr<Tile>> {
+			if (strategy == TilingStrategy::greedy) {
+				return find_best_tile(tree);
+			}
+			auto it = optimal_tilings.find(&tree);
+			if (it == optimal_tilings.end()) {
+				return {};
+			}
+			return mv(it->second.tile);
+		};
+
 		// build a stack to hold pointers to the currently untiled trees.
 		// the top of the stack is for trees that must be executed later
 		Vec<Uptr<Tile>> tiles; // stored in REVERSE order of execution
@@ -1149,7 +1543,7 @@ namespace L3::code_gen::tiles {
 			// try to tile the top tree
 			const ComputationNode *top_tree = untiled_trees.back();
 			untiled_trees.pop_back();
-			Opt<Uptr<Tile>> best_match = find_best_tile(*top_tree);
+			Opt<Uptr<Tile>> best_match = choose_tile(*top_tree);
 			if (!best_match) {
 				std::cerr << "Couldn't find a tile for this tree! " << program::to_string(*top_tree) << "\n";
 				// TODO reject if you can't find a tile
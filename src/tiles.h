@@ -1,5 +1,6 @@
 #pragma once
 #include "program.h"
+#include "l2.h"
 #include "std_alias.h"
 #include <iostream>
 #include <string>
@@ -7,13 +8,37 @@
 namespace L3::code_gen::tiles {
 	using namespace std_alias;
 
+	// state shared by all the tiles of a single function while its code is
+	// being generated. Keeping this per-function (instead of global) lets
+	// functions be generated independently of each other.
+	struct FunctionContext {
+		const L3::program::L3Function &l3_function;
+		int num_call_return_labels; // the number of call-return labels generated so far in this function
+
+		FunctionContext(const L3::program::L3Function &l3_function) :
+			l3_function { l3_function },
+			num_call_return_labels { 0 }
+		{}
+	};
+
 	// interface
 	struct Tile {
-		virtual Vec<std::string> to_l2_instructions() const = 0;
+		// appends the L2 instructions that this tile stands for to `out`
+		virtual void to_l2_instructions(FunctionContext &ctx, Vec<l2::Instruction> &out) const = 0;
 		virtual Vec<const L3::program::ComputationNode *> get_unmatched() const = 0;
+
+		// for the tile patterns whose Structure says everything about when
+		// they match; the others hide this with their own
+		template<typename Structure>
+		static bool accepts(const Structure &) { return true; }
+	};
+
+	enum class TilingStrategy {
+		greedy, // maximal munch, one node at a time from the root down
+		optimal // the minimum total cost of the tiles covering each tree
 	};
 
 	// outputs a vector of matched tiles. these tiles have the same lifetime
 	// as the vector of computation tree boxes
-	Vec<Uptr<Tile>> tile_trees(const Vec<L3::program::ComputationTreeBox> &trees);
+	Vec<Uptr<Tile>> tile_trees(const Vec<L3::program::ComputationTreeBox> &trees, TilingStrategy strategy);
 }
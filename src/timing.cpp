@@ -0,0 +1,154 @@
+#include "timing.h"
+#include <algorithm>
+#include <iomanip>
+#include <numeric>
+#include <time.h>
+
+namespace L3::timing {
+	std::string to_string(Phase phase) {
+		switch (phase) {
+			case Phase::parse: return "parse";
+			case Phase::build_trees: return "build trees";
+			case Phase::inline_calls: return "inlining";
+			case Phase::eliminate_tail_recursion: return "tail recursion";
+			case Phase::data_flow: return "data flow";
+			case Phase::propagate_constants: return "constants";
+			case Phase::simplify_branches: return "branches";
+			case Phase::number_values: return "value numbering";
+			case Phase::hoist_loop_invariants: return "loop invariants";
+			case Phase::eliminate_dead_code: return "dead code";
+			case Phase::merge_trees: return "merge trees";
+			case Phase::lay_out_blocks: return "block layout";
+			case Phase::tile_trees: return "tile trees";
+			case Phase::peephole: return "peephole";
+			case Phase::emit: return "emit";
+			default: return "unknown phase";
+		}
+	}
+
+	Duration &Duration::operator+=(const Duration &other) {
+		this->wall_seconds += other.wall_seconds;
+		this->cpu_seconds += other.cpu_seconds;
+		return *this;
+	}
+
+	Duration PhaseTimes::get_total() const {
+		Duration total;
+		for (const Duration &duration : this->durations) {
+			total += duration;
+		}
+		return total;
+	}
+	PhaseTimes &PhaseTimes::operator+=(const PhaseTimes &other) {
+		for (int i = 0; i < NUM_PHASES; ++i) {
+			this->durations[i] += other.durations[i];
+		}
+		return *this;
+	}
+
+	static double get_thread_cpu_seconds() {
+		timespec ts;
+		clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+		return ts.tv_sec + ts.tv_nsec / 1e9;
+	}
+
+	Stopwatch::Stopwatch() :
+		wall_start { std::chrono::steady_clock::now() },
+		cpu_start { get_thread_cpu_seconds() }
+	{}
+	Duration Stopwatch::get_elapsed() const {
+		Duration result;
+		result.wall_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - this->wall_start).count();
+		result.cpu_seconds = get_thread_cpu_seconds() - this->cpu_start;
+		return result;
+	}
+
+	ScopedPhaseTimer::ScopedPhaseTimer(PhaseTimes *times_nullable, Phase phase) :
+		times_nullable { times_nullable },
+		phase { phase }
+	{
+		if (this->times_nullable) {
+			this->stopwatch.emplace();
+		}
+	}
+	ScopedPhaseTimer::~ScopedPhaseTimer() {
+		if (this->times_nullable) {
+			(*this->times_nullable)[this->phase] += this->stopwatch->get_elapsed();
+		}
+	}
+
+	// wide enough for the longest phase name and a space before it, so the
+	// per-function columns line up under their headers
+	static int get_phase_column_width() {
+		size_t width = 12;
+		for (int i = 0; i < NUM_PHASES; ++i) {
+			width = std::max(width, to_string(static_cast<Phase>(i)).size() + 1);
+		}
+		return static_cast<int>(width);
+	}
+
+	static void print_duration(std::ostream &o, const Duration &duration) {
+		o << std::setw(12) << duration.wall_seconds << std::setw(12) << duration.cpu_seconds;
+	}
+
+	void print_report(
+		std::ostream &o,
+		const PhaseTimes &program_times,
+		const Vec<std::string> &function_names,
+		const Vec<PhaseTimes> &function_times,
+		const Duration &elapsed,
+		int num_slowest
+	) {
+		std::ios_base::fmtflags old_flags = o.flags();
+		std::streamsize old_precision = o.precision();
+		o << std::fixed << std::setprecision(6);
+
+		// the phases summed over every function
+		PhaseTimes summed_times = program_times;
+		for (const PhaseTimes &times : function_times) {
+			summed_times += times;
+		}
+		o << "time report (seconds)\n";
+		o << std::left << std::setw(16) << "phase" << std::right << std::setw(12) << "wall" << std::setw(12) << "cpu" << "\n";
+		for (int i = 0; i < NUM_PHASES; ++i) {
+			o << std::left << std::setw(16) << to_string(static_cast<Phase>(i)) << std::right;
+			print_duration(o, summed_times.durations[i]);
+			o << "\n";
+		}
+		o << std::left << std::setw(16) << "sum of phases" << std::right;
+		print_duration(o, summed_times.get_total());
+		o << "\n";
+		o << std::left << std::setw(16) << "elapsed" << std::right << std::setw(12) << elapsed.wall_seconds << "\n";
+
+		// the slowest functions by total wall time
+		Vec<size_t> order(function_times.size());
+		std::iota(order.begin(), order.end(), 0);
+		size_t num_listed = std::min(order.size(), static_cast<size_t>(num_slowest));
+		std::partial_sort(order.begin(), order.begin() + num_listed, order.end(), [&](size_t a, size_t b) {
+			return function_times[a].get_total().wall_seconds > function_times[b].get_total().wall_seconds;
+		});
+		int column_width = get_phase_column_width();
+		o << "\nslowest " << num_listed << " of " << function_times.size() << " functions (wall)\n";
+		o << std::left << std::setw(24) << "function" << std::right << std::setw(12) << "total";
+		for (int i = 0; i < NUM_PHASES; ++i) {
+			if (static_cast<Phase>(i) != Phase::parse) {
+				o << std::setw(column_width) << to_string(static_cast<Phase>(i));
+			}
+		}
+		o << "\n";
+		for (size_t rank = 0; rank < num_listed; ++rank) {
+			const PhaseTimes &times = function_times[order[rank]];
+			o << std::left << std::setw(24) << ("@" + function_names[order[rank]]) << std::right
+				<< std::setw(12) << times.get_total().wall_seconds;
+			for (int i = 0; i < NUM_PHASES; ++i) {
+				if (static_cast<Phase>(i) != Phase::parse) {
+					o << std::setw(column_width) << times.durations[i].wall_seconds;
+				}
+			}
+			o << "\n";
+		}
+
+		o.flags(old_flags);
+		o.precision(old_precision);
+	}
+}
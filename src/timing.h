@@ -0,0 +1,93 @@
+#pragma once
+
+#include "std_alias.h"
+#include <array>
+#include <chrono>
+#include <iostream>
+#include <string>
+
+namespace L3::timing {
+	using namespace std_alias;
+
+	enum class Phase {
+		parse,
+		build_trees,
+		inline_calls,
+		eliminate_tail_recursion,
+		data_flow,
+		propagate_constants,
+		simplify_branches,
+		number_values,
+		hoist_loop_invariants,
+		eliminate_dead_code,
+		merge_trees,
+		lay_out_blocks,
+		tile_trees,
+		peephole,
+		emit,
+		num_phases
+	};
+	const int NUM_PHASES = static_cast<int>(Phase::num_phases);
+
+	std::string to_string(Phase phase);
+
+	struct Duration {
+		double wall_seconds;
+		double cpu_seconds; // CPU time of the thread that did the work
+
+		Duration() : wall_seconds { 0 }, cpu_seconds { 0 } {}
+		Duration &operator+=(const Duration &other);
+	};
+
+	// The time spent in each phase by one unit of work (a function, or the
+	// whole program).
+	struct PhaseTimes {
+		std::array<Duration, NUM_PHASES> durations;
+
+		Duration &operator[](Phase phase) { return this->durations[static_cast<int>(phase)]; }
+		const Duration &operator[](Phase phase) const { return this->durations[static_cast<int>(phase)]; }
+		Duration get_total() const;
+		PhaseTimes &operator+=(const PhaseTimes &other);
+	};
+
+	// Measures wall and thread CPU time from its construction.
+	class Stopwatch {
+		std::chrono::steady_clock::time_point wall_start;
+		double cpu_start;
+
+		public:
+
+		Stopwatch();
+		Duration get_elapsed() const;
+	};
+
+	// Adds the time from its construction to its destruction to the given
+	// phase. Does nothing (and doesn't read any clocks) if `times_nullable`
+	// is null, so it can be left in place when timing is turned off.
+	class ScopedPhaseTimer {
+		PhaseTimes *times_nullable;
+		Phase phase;
+		Opt<Stopwatch> stopwatch;
+
+		public:
+
+		ScopedPhaseTimer(PhaseTimes *times_nullable, Phase phase);
+		ScopedPhaseTimer(const ScopedPhaseTimer &) = delete;
+		ScopedPhaseTimer &operator=(const ScopedPhaseTimer &) = delete;
+		~ScopedPhaseTimer();
+	};
+
+	// Prints the time of each phase summed over the program, followed by
+	// the `num_slowest` functions that took the longest wall time, to `o`.
+	// `function_names` and `function_times` are parallel. `elapsed` is the
+	// wall time of the whole compile, which is less than the sum of the
+	// phases when functions were compiled in parallel.
+	void print_report(
+		std::ostream &o,
+		const PhaseTimes &program_times,
+		const Vec<std::string> &function_names,
+		const Vec<PhaseTimes> &function_times,
+		const Duration &elapsed,
+		int num_slowest
+	);
+}
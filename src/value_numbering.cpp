@@ -0,0 +1,192 @@
+#include "value_numbering.h"
+#include "analyze_trees.h"
+#include "std_alias.h"
+#include <tuple>
+
+namespace L3::program::analyze {
+	using namespace std_alias;
+
+	// Identifies a computation by the value numbers of its operands.
+	struct ExprKey {
+		enum struct Kind {
+			binary,
+			load
+		};
+
+		Kind kind;
+		Operator op; // only for binary
+		int lhs; // the value number of the lhs, or of the address for a load
+		int rhs; // the value number of the rhs, or the memory version for a load
+
+		bool operator<(const ExprKey &other) const {
+			return std::tie(this->kind, this->op, this->lhs, this->rhs)
+				< std::tie(other.kind, other.op, other.lhs, other.rhs);
+		}
+	};
+
+	class ValueNumberer {
+		int num_values;
+		Map<Variable *, int> var_values;
+		Map<int64_t, int> number_values;
+
+		// the value of each computation seen so far, and a variable it was
+		// left in
+		struct Available {
+			int value;
+			Variable *holder;
+		};
+		Map<ExprKey, Available> available;
+
+		// incremented by everything that might write memory, so that loads
+		// from before it don't match loads after it
+		int memory_version;
+
+		public:
+
+		ValueNumberer() : num_values { 0 }, memory_version { 0 } {}
+
+		int make_value() {
+			return this->num_values++;
+		}
+
+		int get_value(Variable *var) {
+			auto [it, inserted] = this->var_values.insert({ var, 0 });
+			if (inserted) {
+				// not written yet in this block
+				it->second = this->make_value();
+			}
+			return it->second;
+		}
+
+		// Returns the value number of a leaf node, or an empty optional if the
+		// node isn't a variable or number.
+		Opt<int> get_leaf_value(const ComputationNode &node) {
+			if (const VariableCn *var_node = dynamic_cast<const VariableCn *>(&node)) {
+				return this->get_value(*var_node->destination);
+			}
+			if (const NumberCn *number_node = dynamic_cast<const NumberCn *>(&node)) {
+				auto [it, inserted] = this->number_values.insert({ number_node->value, 0 });
+				if (inserted) {
+					it->second = this->make_value();
+				}
+				return it->second;
+			}
+			return {};
+		}
+
+		Opt<ExprKey> get_key(const ComputationNode &tree) {
+			if (const BinaryCn *bin_node = dynamic_cast<const BinaryCn *>(&tree)) {
+				Opt<int> lhs = this->get_leaf_value(*bin_node->lhs);
+				Opt<int> rhs = this->get_leaf_value(*bin_node->rhs);
+				if (!lhs || !rhs) {
+					return {};
+				}
+				// put the operands of a flippable operator in a canonical
+				// order so that e.g. `a + b` matches `b + a` and `a < b`
+				// matches `b > a`
+				Operator op = bin_node->op;
+				if (Opt<Operator> flipped_op = flip_operator(op); flipped_op && *lhs > *rhs) {
+					return ExprKey { ExprKey::Kind::binary, *flipped_op, *rhs, *lhs };
+				}
+				return ExprKey { ExprKey::Kind::binary, op, *lhs, *rhs };
+			}
+			if (const LoadCn *load_node = dynamic_cast<const LoadCn *>(&tree)) {
+				Opt<int> address = this->get_leaf_value(*load_node->address);
+				if (!address) {
+					return {};
+				}
+				return ExprKey { ExprKey::Kind::load, Operator::eq, *address, this->memory_version };
+			}
+			return {};
+		}
+
+		// Finds the variable holding the value of `key` if it still holds
+		// it.
+		Opt<Available> find(const ExprKey &key) {
+			auto it = this->available.find(key);
+			if (it == this->available.end() || this->get_value(it->second.holder) != it->second.value) {
+				return {};
+			}
+			return it->second;
+		}
+
+		void make_available(const ExprKey &key, int value, Variable *holder) {
+			this->available.insert_or_assign(key, Available { value, holder });
+		}
+
+		void set_value(Variable *var, int value) {
+			this->var_values.insert_or_assign(var, value);
+		}
+
+		void clobber_memory() {
+			this->memory_version += 1;
+		}
+
+		// Numbers the tree and, if its value is already available in a
+		// variable, replaces it with a move from that variable.
+		void visit(ArenaUptr<ComputationNode> &tree, Arena &arena) {
+			if (CallCn *call_node = dynamic_cast<CallCn *>(tree.get())) {
+				// the memory a call allocates has no loads available yet
+				if (get_call_effects(*call_node).writes_memory) {
+					this->clobber_memory();
+				}
+			} else if (StoreCn *store_node = dynamic_cast<StoreCn *>(tree.get())) {
+				this->clobber_memory();
+				// a load right after this store gets the value stored
+				Opt<int> address = this->get_leaf_value(*store_node->address);
+				if (address) {
+					if (VariableCn *var_node = dynamic_cast<VariableCn *>(store_node->value.get())) {
+						Variable *stored_var = *var_node->destination;
+						this->make_available(
+							{ ExprKey::Kind::load, Operator::eq, *address, this->memory_version },
+							this->get_value(stored_var),
+							stored_var
+						);
+					}
+				}
+				return;
+			}
+
+			if (!tree->destination) {
+				return;
+			}
+			Variable *dest = *tree->destination;
+
+			// the value that the destination ends up with
+			int value;
+			if (MoveCn *move_node = dynamic_cast<MoveCn *>(tree.get())) {
+				Opt<int> source_value = this->get_leaf_value(*move_node->source);
+				value = source_value ? *source_value : this->make_value();
+			} else if (is_dynamic_type<NumberCn>(*tree)) {
+				value = *this->get_leaf_value(*tree);
+			} else if (Opt<ExprKey> key = this->get_key(*tree)) {
+				if (Opt<Available> available = this->find(*key)) {
+					// if the holder is the destination itself, this becomes a
+					// self-move, which the peephole pass removes
+					value = available->value;
+					tree = arena.make<MoveCn>(dest, arena.make<VariableCn>(available->holder));
+				} else {
+					value = this->make_value();
+					// the destination must be written before it can be
+					// recorded as the holder, in case it is also an operand
+					this->set_value(dest, value);
+					this->make_available(*key, value, dest);
+					return;
+				}
+			} else {
+				value = this->make_value();
+			}
+			this->set_value(dest, value);
+		}
+	};
+
+	void number_values(L3Function &l3_function) {
+		Arena &arena = l3_function.get_node_arena();
+		for (Uptr<BasicBlock> &block : l3_function.get_blocks()) {
+			ValueNumberer numberer;
+			for (ComputationTreeBox &tree_box : block->get_tree_boxes()) {
+				numberer.visit(tree_box.get_tree(), arena);
+			}
+		}
+	}
+}
@@ -0,0 +1,14 @@
+#pragma once
+#include "program.h"
+
+namespace L3::program::analyze {
+	// Local value numbering. Within each block, a tree that computes a value
+	// that an earlier tree already left in a variable (which hasn't been
+	// overwritten since) is replaced by a move from that variable. Loads are
+	// only reused while no store or call has happened in between, and a
+	// store makes the value stored available to later loads of the same
+	// address.
+	// Assumes the trees haven't been merged yet. Doesn't change the liveness
+	// of any block, so the data flow stays valid.
+	void number_values(L3Function &l3_function);
+}